@@ -14,11 +14,14 @@
 #include <QTextDocument>
 #include <QTextBlock>
 #include <QPixmap>   // For setting custom icon
+#include <QPainter>
+#include <QImage>
 #include <QScrollArea>
 #include <QDir>
 #include <QDateTime>
 #include <algorithm>
 #include <sstream>
+#include <cmath>
 
 InputWindow::InputWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -30,6 +33,14 @@ InputWindow::InputWindow(QWidget *parent)
     // Configure image label for proper scaling
     ui->imageLabel->setAlignment(Qt::AlignCenter);
     ui->imageLabel->setScaledContents(false);
+
+    document.setErrorRecovery(true); // list every error in the message box
+
+    // Apply every change in the editor to 'document' as it happens, so a
+    // click has nothing left to scan or parse
+    QTextDocument* text = ui->inputField->document();
+    document.load(editorText(0, text->characterCount() - 1));
+    connect(text, &QTextDocument::contentsChange, this, &InputWindow::applyEditorChange);
 }
 
 InputWindow::~InputWindow()
@@ -103,168 +114,233 @@ void InputWindow::on_pushButton_3_clicked()
     saveOutput();
 }
 
+// 'count' characters of editor text from 'position', as 'document' holds
+// them: one byte per UTF-16 character, so editor positions are byte
+// offsets. Characters outside Latin-1 become '?', which scans the same as
+// any other byte TINY has no use for.
+std::string InputWindow::editorText(int position, int count) const
+{
+    QTextCursor cursor(ui->inputField->document());
+    cursor.setPosition(position);
+    cursor.setPosition(position + count, QTextCursor::KeepAnchor);
+    QString text = cursor.selectedText();
+
+    // selectedText() ends lines with U+2029; normalize newlines as well
+    text.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    text.replace(QChar::LineSeparator, QLatin1Char('\n'));
+    text.replace(QLatin1Char('\r'), QLatin1Char('\n'));
+    QByteArray bytes = text.toLatin1();
+    return std::string(bytes.constData(), (size_t)bytes.size());
+}
+
+// Token text as the editor showed it (see editorText())
+QString tokenText(const Token& token)
+{
+    return QString::fromLatin1(token.value.data(), (int)token.value.size());
+}
+
+// One numbered line per token; 'count' carries the numbering across calls
+QString tokenLines(const std::vector<Token>& list, int& count)
+{
+    QString lines;
+    for (const auto& token : list) {
+        if (token.type == TokenType::END_OF_FILE) continue;
+        count++;
+        lines += QString("%1. %2, %3\n")
+            .arg(count)
+            .arg(token.value.empty() ? QString("<empty>") : tokenText(token))
+            .arg(QString::fromStdString(tokenTypeToString(token.type)));
+    }
+    return lines;
+}
+
+void InputWindow::applyEditorChange(int position, int removed, int added)
+{
+    treeImage = QImage(); // no longer shows the text
+
+    // Replacing the whole text counts the document's final paragraph
+    // separator on both sides, one character past the end
+    size_t length = (size_t)ui->inputField->document()->characterCount() - 1;
+    size_t offset = (size_t)position;
+    if (offset <= length && offset <= document.size()) {
+        size_t erased = std::min((size_t)removed, document.size() - offset);
+        size_t inserted = std::min((size_t)added, length - offset);
+        if (document.size() - erased + inserted == length) {
+            document.edit(offset, erased, editorText(position, (int)inserted));
+            return;
+        }
+    }
+    // Out of step with the editor; start over from its text
+    document.load(editorText(0, (int)length));
+}
+
 void InputWindow::processInput()
 {
     // Process as code
     scanCode();
     
     // Parse the tokens and display syntax tree
-    if (!tokens.empty()) {
+    if (document.tokenCount() > 0) {
         parseTokens();
-        displaySyntaxTree();
+        if (document.success()) {
+            displaySyntaxTree();
+        }
     }
 }
 
 void InputWindow::scanCode()
 {
-    // Get input text from the plain text edit
-    QString inputText = ui->inputField->toPlainText();
-    std::string code = inputText.toStdString();
-    
-    // Normalize newlines
-    std::replace(code.begin(), code.end(), '\r', '\n');
-    
-    // Create scanner and scan the code
-    Scanner scanner(code);
-    tokens = scanner.scanAll();
-    
-    if (tokens.empty()) {
+    // applyEditorChange() already scanned the text
+    if (document.tokenCount() == 0) {
         QMessageBox::warning(this, "Scan Error", "No tokens found in the input code.");
     } else {
         // Display tokens in the UI
         displayTokensInUI();
-        ui->statusbar->showMessage(QString("Successfully scanned %1 tokens.").arg(tokens.size()), 3000);
+        ui->statusbar->showMessage(QString("Successfully scanned %1 tokens.").arg(document.tokenCount()), 3000);
     }
 }
 
 void InputWindow::scanTokens()
 {
     // Parse tokens from input field (format: token_value,token_type)
-    QString inputText = ui->inputField->toPlainText();
+    // Token values view into 'source', so keep the text as a std::string
+    source = ui->inputField->toPlainText().toStdString();
     tokens.clear();
     
-    QStringList lines = inputText.split('\n', Qt::SkipEmptyParts);
-    
-    for (const QString& line : lines) {
-        QString trimmed = line.trimmed();
-        if (trimmed.isEmpty()) continue;
-        
-        QStringList parts = trimmed.split(',');
-        if (parts.size() >= 2) {
-            std::string value = parts[0].trimmed().toStdString();
-            std::string typeStr = parts[1].trimmed().toStdString();
-            
-            TokenType type = stringToTokenType(typeStr);
-            tokens.push_back(Token(value, type));
-        }
+    // Same single-pass reader as tiny_compiler --tokens; an unknown type
+    // name is read as UNKNOWN
+    TokenBuffer read;
+    TokenTextReader reader(source.data(), source.size());
+    reader.read(read);
+    tokens.reserve(read.size() + 1);
+    for (size_t i = 0; i < read.size(); i++) {
+        tokens.push_back(read[i]);
     }
     
     // Add EOF token if not present
     if (tokens.empty() || tokens.back().type != TokenType::END_OF_FILE) {
-        tokens.push_back(Token("", TokenType::END_OF_FILE));
+        tokens.push_back(Token(SourceView(), TokenType::END_OF_FILE));
     }
     
     if (tokens.size() <= 1) {
         QMessageBox::warning(this, "Parse Error", "No valid tokens found. Format: value,TYPE");
     } else {
         // Display tokens in the UI
-        displayTokensInUI();
+        int count = 0;
+        ui->tokensOutput->setPlainText(tokenLines(tokens, count));
+        ui->tabWidget->setCurrentIndex(0); // Switch to tokens tab
         ui->statusbar->showMessage(QString("Successfully loaded %1 tokens.").arg(tokens.size() - 1), 3000);
     }
 }
 
 void InputWindow::displayTokensInUI()
 {
-    // Display tokens in the tokens tab
-    QString tokenText;
+    // Display the tokens of every statement in the tokens tab
+    QString lines;
     int count = 0;
-    
-    for (const auto& token : tokens) {
-        if (token.type == TokenType::END_OF_FILE) continue;
-        count++;
-        tokenText += QString("%1. %2, %3\n")
-            .arg(count)
-            .arg(QString::fromStdString(token.value).isEmpty() ? "<empty>" : QString::fromStdString(token.value))
-            .arg(QString::fromStdString(tokenTypeToString(token.type)));
+    for (size_t i = 0; i < document.statementCount(); i++) {
+        lines += tokenLines(document.statementTokens(i), count);
     }
     
-    ui->tokensOutput->setPlainText(tokenText);
+    ui->tokensOutput->setPlainText(lines);
     ui->tabWidget->setCurrentIndex(0); // Switch to tokens tab
 }
 
 void InputWindow::parseTokens()
 {
-    if (tokens.empty()) {
+    if (document.tokenCount() == 0) {
         QMessageBox::warning(this, "Parse Error", "No tokens to parse.");
         return;
     }
     
-    TinyParser parser;
-    TinyParser::ParseResult result = parser.parse(tokens);
-    
-    if (result.success) {
-        syntaxTree = result.ast;
+    // applyEditorChange() already parsed the text
+    if (document.success()) {
         ui->statusbar->showMessage("Successfully parsed the input!", 3000);
     } else {
         QString errorMsg = "Parse errors occurred:\n";
-        for (const auto& error : result.errors) {
-            errorMsg += QString::fromStdString(error) + "\n";
+        for (const auto& error : document.errors()) {
+            errorMsg += QString::fromLatin1(error.data(), (int)error.size()) + "\n";
         }
         QMessageBox::critical(this, "Parse Error", errorMsg);
     }
 }
 
+// Draw a syntax tree with the in-process layout (TinyLayout.h), scaled
+// down if needed to keep the image within QImage's limits
+QImage renderSyntaxTree(const SyntaxTree& tree) {
+    TreeLayout layout(tree);
+
+    const double maxSide = 32000;
+    const double maxPixels = 100e6;
+    double scale = 1;
+    if (layout.width() * scale > maxSide) scale = maxSide / layout.width();
+    if (layout.height() * scale > maxSide) scale = maxSide / layout.height();
+    double pixels = layout.width() * layout.height() * scale * scale;
+    if (pixels > maxPixels) scale *= std::sqrt(maxPixels / pixels);
+
+    QImage image((int)std::ceil(layout.width() * scale), (int)std::ceil(layout.height() * scale),
+                 QImage::Format_RGB32);
+    if (image.isNull()) return image;
+    image.fill(Qt::white);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.scale(scale, scale);
+    QFont font("Arial");
+    font.setPixelSize((int)kLayoutFontSize);
+    painter.setFont(font);
+    painter.setPen(Qt::black);
+    painter.setBrush(Qt::white);
+
+    const std::vector<TreeLayout::PlacedNode>& nodes = layout.nodes();
+    for (const TreeLayout::Edge& e : layout.edges()) {
+        const TreeLayout::PlacedNode& a = nodes[e.from];
+        const TreeLayout::PlacedNode& b = nodes[e.to];
+        if (e.sameRow) {
+            painter.drawLine(QPointF(a.x + a.width / 2, a.y), QPointF(b.x - b.width / 2, b.y));
+        } else {
+            painter.drawLine(QPointF(a.x, a.y + a.height / 2), QPointF(b.x, b.y - b.height / 2));
+        }
+    }
+    for (const TreeLayout::PlacedNode& p : nodes) {
+        QRectF rect(p.x - p.width / 2, p.y - p.height / 2, p.width, p.height);
+        if (p.box) {
+            painter.drawRect(rect);
+        } else {
+            painter.drawEllipse(rect);
+        }
+        QString label = QString::fromLatin1(layout.kindLabel(p));
+        SourceView value = layout.valueLabel(p);
+        if (!value.empty()) {
+            label += "\n" + QString::fromUtf8(value.data(), (int)value.size());
+        }
+        painter.drawText(rect, Qt::AlignCenter, label);
+    }
+    painter.end();
+    return image;
+}
+
 void InputWindow::displaySyntaxTree()
 {
-    if (!syntaxTree) {
+    const SyntaxTree& syntaxTree = document.tree();
+    if (syntaxTree.empty()) {
         QMessageBox::warning(this, "Display Error", "No syntax tree to display.");
         return;
     }
     
-    // Generate DOT format and save to temporary file
-    std::string dotContent = syntaxTree->toGraphViz();
-    
-    QString dotPath = QDir::temp().filePath("syntax_tree.dot");
-    QFile dotFile(dotPath);
-    if (!dotFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, "Error", "Could not create temporary DOT file.");
+    // Lay out and draw the tree in-process; no GraphViz needed
+    treeImage = renderSyntaxTree(syntaxTree);
+    if (treeImage.isNull()) {
+        QMessageBox::warning(this, "Error", "Could not draw the syntax tree.");
         return;
     }
     
-    QTextStream out(&dotFile);
-    out << QString::fromStdString(dotContent);
-    dotFile.close();
-    
-    // Generate PNG to temporary location
-    QString pngPath = QDir::temp().filePath("syntax_tree.png");
-    
-    QString command = QString("dot -Tpng \"%1\" -o \"%2\"").arg(dotPath).arg(pngPath);
-    int result = system(command.toStdString().c_str());
-    
-    if (result == 0 && QFile::exists(pngPath)) {
-        // Load and display the image at full size
-        QPixmap pixmap(pngPath);
-        if (!pixmap.isNull()) {
-            // Display image at full size - scroll area will handle scrolling
-            ui->imageLabel->setPixmap(pixmap);
-            ui->imageLabel->adjustSize(); // Resize label to fit the full image
-            ui->imageLabel->setScaledContents(false);
-            currentImagePath = pngPath;
-            ui->tabWidget->setCurrentIndex(1); // Switch to syntax tree tab
-            ui->statusbar->showMessage("Syntax tree generated and displayed successfully! Use scroll to view full image.", 3000);
-        } else {
-            QMessageBox::warning(this, "Error", "Could not load the generated image.");
-        }
-    } else {
-        QMessageBox::warning(this, "GraphViz Error", 
-            "Could not generate PNG. Make sure GraphViz is installed.\n"
-            "You can install it from: https://graphviz.org/download/\n\n"
-            "DOT file saved at: " + dotPath);
-        
-        // Show DOT content as fallback
-        ui->imageLabel->setText("GraphViz not found. Install GraphViz to view the syntax tree image.\n\nDOT file location: " + dotPath);
-        ui->tabWidget->setCurrentIndex(1);
-    }
+    // Display image at full size - scroll area will handle scrolling
+    ui->imageLabel->setPixmap(QPixmap::fromImage(treeImage));
+    ui->imageLabel->adjustSize(); // Resize label to fit the full image
+    ui->imageLabel->setScaledContents(false);
+    ui->tabWidget->setCurrentIndex(1); // Switch to syntax tree tab
+    ui->statusbar->showMessage("Syntax tree generated and displayed successfully! Use scroll to view full image.", 3000);
 }
 
 void InputWindow::saveOutput()
@@ -286,6 +362,7 @@ void InputWindow::saveOutput()
     QString timestamp = QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss");
     
     // Save tokens to text file
+    const SyntaxTree& syntaxTree = document.tree();
     QString tokensFilePath = saveDirectory + "/tokens_" + timestamp + ".txt";
     QFile tokensFile(tokensFilePath);
     if (tokensFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
@@ -293,15 +370,17 @@ void InputWindow::saveOutput()
         
         // Save tokens
         out << "=== TOKENS ===\n";
-        for (const auto& token : tokens) {
-            out << QString::fromStdString(token.value) << ", " 
-                << QString::fromStdString(tokenTypeToString(token.type)) << "\n";
+        for (size_t i = 0; i < document.statementCount(); i++) {
+            for (const auto& token : document.statementTokens(i)) {
+                out << tokenText(token) << ", "
+                    << QString::fromStdString(tokenTypeToString(token.type)) << "\n";
+            }
         }
         
         // Save syntax tree text representation
-        if (syntaxTree) {
+        if (!syntaxTree.empty()) {
             out << "\n=== SYNTAX TREE ===\n";
-            out << QString::fromStdString(syntaxTree->toString());
+            out << QString::fromStdString(syntaxTree.toString());
         }
         
         tokensFile.close();
@@ -310,34 +389,27 @@ void InputWindow::saveOutput()
         return;
     }
     
-    // Save PNG image if it exists
+    // Save the drawn tree as PNG, if it still matches the text, and as SVG
     QString savedFiles = "Tokens saved to: " + tokensFilePath;
     
-    if (!currentImagePath.isEmpty() && QFile::exists(currentImagePath)) {
+    if (!treeImage.isNull()) {
         QString pngFilePath = saveDirectory + "/syntax_tree_" + timestamp + ".png";
-        
-        if (QFile::copy(currentImagePath, pngFilePath)) {
+        if (treeImage.save(pngFilePath, "PNG")) {
             savedFiles += "\n\nSyntax tree image saved to: " + pngFilePath;
-        } else {
-            // If copy fails, try to regenerate the PNG
-            if (syntaxTree) {
-                std::string dotContent = syntaxTree->toGraphViz();
-                QString dotPath = saveDirectory + "/syntax_tree_" + timestamp + ".dot";
-                
-                QFile dotFile(dotPath);
-                if (dotFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-                    QTextStream out(&dotFile);
-                    out << QString::fromStdString(dotContent);
-                    dotFile.close();
-                    
-                    QString command = QString("dot -Tpng \"%1\" -o \"%2\"").arg(dotPath).arg(pngFilePath);
-                    int result = system(command.toStdString().c_str());
-                    
-                    if (result == 0) {
-                        savedFiles += "\n\nSyntax tree image saved to: " + pngFilePath;
-                    }
-                }
-            }
+        }
+    }
+    if (!syntaxTree.empty()) {
+        std::string svg;
+        {
+            StringSink out(svg);
+            TreeLayout(syntaxTree).writeSVG(out);
+        }
+        QString svgFilePath = saveDirectory + "/syntax_tree_" + timestamp + ".svg";
+        QFile svgFile(svgFilePath);
+        if (svgFile.open(QIODevice::WriteOnly)) {
+            svgFile.write(svg.data(), (qint64)svg.size());
+            svgFile.close();
+            savedFiles += "\n\nSyntax tree drawing saved to: " + svgFilePath;
         }
     }
     
@@ -2,11 +2,14 @@
 #define INPUTWINDOW_H
 
 #include <QMainWindow>
+#include <QImage>
 #include <memory>
 #include <vector>
 #include "../../include/TinyCommon.h"
 #include "../../include/TinyScanner.h"
 #include "../../include/TinyParser.h"
+#include "../../include/TinyIncremental.h"
+#include "../../include/TinyTokenText.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -26,17 +29,20 @@ private slots:
     void on_pushButton_clicked();        // Browse button
     void on_pushButton_2_clicked();      // Show Syntax Tree button
     void on_pushButton_3_clicked();      // Save button
+    void applyEditorChange(int position, int removed, int added); // Keeps 'document' in step
 
 private:
     Ui::InputWindow *ui;
     void setWallpaper(); // Function declaration for setting wallpaper
     
     // Backend integration variables
-    std::vector<Token> tokens;
-    std::shared_ptr<ASTNode> syntaxTree;
-    QString currentImagePath; // Store path to generated image
+    std::string source;        // Text scanTokens() tokens view into
+    std::vector<Token> tokens; // Tokens read by scanTokens(), views into 'source'
+    IncrementalParser document; // Editor text; only edited statements are re-scanned and re-parsed
+    QImage treeImage;          // Tree last drawn, cleared when the text changes
     
     // Helper methods
+    std::string editorText(int position, int count) const;
     void processInput();
     void scanCode();
     void scanTokens();
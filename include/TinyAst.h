@@ -0,0 +1,399 @@
+#ifndef TINY_AST_H
+#define TINY_AST_H
+
+#include "TinyCommon.h"
+#include "TinyOutput.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Kind of a syntax tree node
+enum class NodeKind : uint8_t {
+    PROGRAM,
+    STATEMENT_SEQUENCE,
+    IF_STATEMENT,
+    REPEAT_STATEMENT,
+    ASSIGN_STATEMENT,
+    READ_STATEMENT,
+    WRITE_STATEMENT,
+    COMPARISON_OP,
+    ADDITIVE_OP,
+    MULTIPLICATIVE_OP,
+    NUMBER,
+    IDENTIFIER
+};
+
+// Name shown for a node kind in tree listings and diagrams
+inline const char* nodeKindToString(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::PROGRAM: return "Program";
+        case NodeKind::STATEMENT_SEQUENCE: return "Statement-Sequence";
+        case NodeKind::IF_STATEMENT: return "If-Statement";
+        case NodeKind::REPEAT_STATEMENT: return "Repeat-Statement";
+        case NodeKind::ASSIGN_STATEMENT: return "Assign-Statement";
+        case NodeKind::READ_STATEMENT: return "Read-Statement";
+        case NodeKind::WRITE_STATEMENT: return "Write-Statement";
+        case NodeKind::COMPARISON_OP: return "Comparison-Op";
+        case NodeKind::ADDITIVE_OP: return "Additive-Op";
+        case NodeKind::MULTIPLICATIVE_OP: return "Multiplicative-Op";
+        case NodeKind::NUMBER: return "Number";
+        case NodeKind::IDENTIFIER: return "Identifier";
+        default: return "Unknown";
+    }
+}
+
+// Statements and statement sequences are drawn as boxes and chained
+// side by side in the diagram
+inline bool isStatementKind(NodeKind kind) {
+    return kind >= NodeKind::STATEMENT_SEQUENCE && kind <= NodeKind::WRITE_STATEMENT;
+}
+
+typedef uint32_t NodeId;
+
+// One syntax tree node. Its children are 'childCount' consecutive entries
+// of the tree's child index list, starting at 'firstChild'.
+struct ASTNode {
+    SourceView value;
+    uint32_t firstChild;
+    uint32_t childCount;
+    NodeKind kind;
+};
+
+// Syntax tree stored in two flat arrays: the nodes, and the child index
+// lists of all nodes back to back. Nodes are added bottom-up, each after
+// its children, so the root is the last node added. Node values view into
+// the token source, which must outlive the tree. Destroying or clearing
+// the tree frees it in one step.
+class SyntaxTree {
+    std::vector<ASTNode> nodes;
+    std::vector<NodeId> childIds;
+
+    // Printers walk the tree with an explicit stack, so deep nesting does
+    // not recurse on the native stack
+
+    void writeNodeLine(NodeId id, size_t level, OutputSink& out) const {
+        const ASTNode& n = nodes[id];
+        out.fill(' ', level * 2);
+        out.write(nodeKindToString(n.kind));
+        if (!n.value.empty()) {
+            out.write(" (", 2);
+            out.write(n.value);
+            out.put(')');
+        }
+        out.put('\n');
+    }
+
+    // A node being listed by writeTree, and its next child to list
+    struct TreeFrame {
+        NodeId id;
+        uint32_t next;
+    };
+
+    // A node being drawn by toDot, with the state it keeps across children
+    struct DotFrame {
+        NodeId id;
+        int myId;
+        int flag;
+        uint32_t visited;       // children entered so far
+        uint32_t firstChild;    // first statement child, or childCount
+        int firstChildId;
+        int childStartId;       // DOT id of the child last entered
+    };
+
+    static void writeDotNode(OutputSink& out, int id) {
+        out.write("node", 4);
+        out.writeNumber((unsigned long long)id);
+    }
+
+    // "  nodeA -- nodeB;" plus an optional attribute list before the ';'
+    static void writeDotEdge(OutputSink& out, int from, int to, const char* attributes = "") {
+        out.write("  ", 2);
+        writeDotNode(out, from);
+        out.write(" -- ", 4);
+        writeDotNode(out, to);
+        out.write(attributes);
+        out.write(";\n", 2);
+    }
+
+    // " { rank = same; nodeA ; nodeB;}"
+    static void writeDotRank(OutputSink& out, int a, int b) {
+        out.write(" { rank = same; ");
+        writeDotNode(out, a);
+        out.write(" ; ", 3);
+        writeDotNode(out, b);
+        out.write(";}\n", 3);
+    }
+
+    // Emit the DOT node for 'id' and push its frame. nodeNums[id] records
+    // the DOT node each tree node was drawn as (or, for undrawn sequences,
+    // the DOT node of its first child).
+    void enterDot(NodeId id, int& nodeCounter, std::vector<int>& nodeNums,
+                  std::vector<DotFrame>& stack, OutputSink& out) const {
+        const ASTNode& n = nodes[id];
+        DotFrame f;
+        f.id = id;
+        f.myId = nodeCounter;
+        f.flag = 0;
+        f.visited = 0;
+        f.firstChild = n.childCount;
+        f.firstChildId = -1;
+        f.childStartId = -1;
+        nodeNums[id] = f.myId;
+
+        // Program and sequences are not drawn; statements are boxes,
+        // expression nodes ellipses
+        const char* shape;
+        switch (n.kind) {
+            case NodeKind::PROGRAM:
+            case NodeKind::STATEMENT_SEQUENCE:
+                stack.push_back(f);
+                return;
+            case NodeKind::IF_STATEMENT:
+            case NodeKind::REPEAT_STATEMENT:
+            case NodeKind::ASSIGN_STATEMENT:
+            case NodeKind::READ_STATEMENT:
+            case NodeKind::WRITE_STATEMENT:
+                shape = "box";
+                break;
+            default:
+                shape = "ellipse";
+                break;
+        }
+        f.flag = 1;
+        nodeCounter++;
+
+        out.write("  ", 2);
+        writeDotNode(out, f.myId);
+        out.write(" [shape=");
+        out.write(shape);
+        out.write(", fontname=\"Arial\", label=\"");
+        out.write(nodeKindToString(n.kind));
+        if (!n.value.empty()) {
+            // The value on a second line, with quotes escaped
+            out.write("\\n", 2);
+            const char* text = n.value.data();
+            size_t begin = 0;
+            for (size_t i = 0; i < n.value.size(); i++) {
+                if (text[i] == '"') {
+                    out.write(text + begin, i - begin);
+                    out.write("\\\"", 2);
+                    begin = i + 1;
+                }
+            }
+            out.write(text + begin, n.value.size() - begin);
+        }
+        out.write("\"];\n", 4);
+        stack.push_back(f);
+    }
+
+    // Edges from the node of frame 'f' to its child 'i', drawn after the child
+    void childDotEdges(const DotFrame& f, uint32_t i, OutputSink& out) const {
+        const ASTNode& n = nodes[f.id];
+        if(!f.flag) return;
+        if(isStatementKind(nodes[child(n, i)].kind)) {
+            if(f.firstChild == i)
+                writeDotEdge(out, f.myId, f.childStartId);
+            else {
+                if(n.kind == NodeKind::IF_STATEMENT && n.childCount>2 && i == n.childCount-1) {
+                    writeDotEdge(out, f.myId, f.childStartId);
+                }else {
+                    writeDotEdge(out, f.firstChildId, f.childStartId);
+                    writeDotRank(out, f.firstChildId, f.childStartId);
+                }
+
+            }
+        }else {
+            writeDotEdge(out, f.myId, f.childStartId);
+        }
+    }
+
+    // Layout hints drawn after all children of the node of frame 'f'
+    void closeDot(const DotFrame& f, const std::vector<int>& nodeNums, OutputSink& out) const {
+        const ASTNode& n = nodes[f.id];
+        switch (n.kind) {
+            case NodeKind::STATEMENT_SEQUENCE:
+                for (uint32_t i=1; i<n.childCount; i++) {
+                    writeDotEdge(out, nodeNums[child(n, i-1)], nodeNums[child(n, i)]);
+                }
+                out.write(" subgraph sub");
+                out.writeNumber((unsigned long long)f.myId);
+                out.write(" { rank = same;");
+                for (uint32_t i=0; i<n.childCount; i++) {
+                    out.put(' ');
+                    writeDotNode(out, nodeNums[child(n, i)]);
+                    out.write(" ; ", 3);
+                }
+                out.write("}\n", 2);
+                break;
+            case NodeKind::IF_STATEMENT: {
+                int test = nodeNums[child(n, 0)];
+                int then = nodeNums[child(n, 1)];
+                writeDotEdge(out, test, then, "[style=invis]");
+                writeDotRank(out, test, then);
+                break;
+            }
+            case NodeKind::REPEAT_STATEMENT: {
+                const ASTNode& body = nodes[child(n, n.childCount-2)];
+                int bodyLast = nodeNums[child(body, body.childCount-1)];
+                int until = nodeNums[child(n, n.childCount-1)];
+                writeDotEdge(out, bodyLast, until, "[style=invis]");
+                writeDotRank(out, until, bodyLast);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+public:
+    // Drop all nodes, keeping the allocated capacity for the next tree
+    void clear() {
+        nodes.clear();
+        childIds.clear();
+    }
+
+    void swap(SyntaxTree& other) {
+        nodes.swap(other.nodes);
+        childIds.swap(other.childIds);
+    }
+
+    // Add a node whose children (added earlier) are kids[0..count)
+    NodeId addNode(NodeKind kind, SourceView value, const NodeId* kids, uint32_t count) {
+        ASTNode n;
+        n.value = value;
+        n.firstChild = (uint32_t)childIds.size();
+        n.childCount = count;
+        n.kind = kind;
+        childIds.insert(childIds.end(), kids, kids + count);
+        nodes.push_back(n);
+        return (NodeId)(nodes.size() - 1);
+    }
+
+    // Copy the first 'count' nodes of 'other', with their child lists, to
+    // the end of this tree. Returns the id the first copied node gets; the
+    // copy of node i of 'other' is that id + i.
+    NodeId appendNodes(const SyntaxTree& other, NodeId count) {
+        NodeId offset = (NodeId)nodes.size();
+        uint32_t childOffset = (uint32_t)childIds.size();
+        size_t childEnd = 0;
+        if (count > 0) {
+            const ASTNode& last = other.nodes[count - 1];
+            childEnd = last.firstChild + last.childCount;
+        }
+
+        for (NodeId i = 0; i < count; i++) {
+            ASTNode n = other.nodes[i];
+            n.firstChild += childOffset;
+            nodes.push_back(n);
+        }
+        for (size_t i = 0; i < childEnd; i++) {
+            childIds.push_back(other.childIds[i] + offset);
+        }
+        return offset;
+    }
+
+    // Copy the top-level statements of 'program' (a Program tree) to the
+    // end of this tree and add their new ids to 'statements'. Used to build
+    // one Program out of programs parsed separately.
+    void appendStatements(const SyntaxTree& program, std::vector<NodeId>& statements) {
+        // The statements come first: a Program's sequence and the Program
+        // node itself are the last two nodes added
+        NodeId seq = program.child(program.node(program.root()), 0);
+        const ASTNode& seqNode = program.node(seq);
+        NodeId offset = appendNodes(program, seq);
+        for (uint32_t k = 0; k < seqNode.childCount; k++) {
+            statements.push_back(offset + program.child(seqNode, k));
+        }
+    }
+
+    bool empty() const { return nodes.empty(); }
+    size_t size() const { return nodes.size(); }
+    NodeId root() const { return (NodeId)(nodes.size() - 1); }
+
+    const ASTNode& node(NodeId id) const { return nodes[id]; }
+    NodeId child(const ASTNode& n, uint32_t i) const { return childIds[n.firstChild + i]; }
+
+    // Bytes used by the tree, excluding spare capacity
+    size_t bytesUsed() const {
+        return nodes.size() * sizeof(ASTNode) + childIds.size() * sizeof(NodeId);
+    }
+
+    // Write the indented tree listing to 'out', one line per node. Takes
+    // linear time and memory proportional to the depth of the tree.
+    void writeTree(OutputSink& out) const {
+        if (empty()) return;
+
+        // The path from the root to the node listed last
+        std::vector<TreeFrame> path;
+        writeNodeLine(root(), 0, out);
+        path.push_back(TreeFrame{root(), 0});
+        while (!path.empty()) {
+            TreeFrame& f = path.back();
+            const ASTNode& n = nodes[f.id];
+            if (f.next == n.childCount) {
+                path.pop_back();
+                continue;
+            }
+            NodeId c = child(n, f.next++);
+            writeNodeLine(c, path.size(), out);
+            path.push_back(TreeFrame{c, 0});
+        }
+    }
+
+    std::string toString() const {
+        std::string result;
+        StringSink out(result);
+        writeTree(out);
+        out.flush();
+        return result;
+    }
+
+    // Write the tree in GraphViz DOT format to 'out', in linear time
+    void writeGraphViz(OutputSink& out) const {
+        int counter = 0;
+        out.write("graph SyntaxTree {\n");
+        out.write("  graph [rankdir=TB];\n");
+        out.write("  node [fontname=\"Arial\"];\n");
+        out.write("  edge [fontname=\"Arial\"];\n\n");
+
+        if (!empty()) {
+            std::vector<int> nodeNums(nodes.size(), -1);
+            std::vector<DotFrame> stack;
+            enterDot(root(), counter, nodeNums, stack, out);
+            while (!stack.empty()) {
+                DotFrame& f = stack.back();
+                const ASTNode& n = nodes[f.id];
+                if (f.visited > 0 && f.childStartId >= 0) {
+                    childDotEdges(f, f.visited - 1, out);
+                    f.childStartId = -1;
+                }
+                if (f.visited < n.childCount) {
+                    // Add edges to children
+                    uint32_t i = f.visited++;
+                    NodeId c = child(n, i);
+                    f.childStartId = counter;
+                    if(f.firstChildId == -1 && isStatementKind(nodes[c].kind)) {
+                        f.firstChild = i;
+                        f.firstChildId = f.childStartId;
+                    }
+                    enterDot(c, counter, nodeNums, stack, out);
+                    continue;
+                }
+                closeDot(f, nodeNums, out);
+                stack.pop_back();
+            }
+        }
+        out.write("}\n", 2);
+    }
+
+    // Generate GraphViz DOT format for visualization
+    std::string toGraphViz() const {
+        std::string result;
+        StringSink out(result);
+        writeGraphViz(out);
+        out.flush();
+        return result;
+    }
+};
+
+#endif // TINY_AST_H
@@ -0,0 +1,396 @@
+#ifndef TINY_BYTECODE_H
+#define TINY_BYTECODE_H
+
+#include "TinyCommon.h"
+#include "TinyAst.h"
+#include "TinyOutput.h"
+#include "TinyInterpreter.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Register bytecode for TINY programs, run by VirtualMachine (TinyVM.h).
+//
+// Registers are 64-bit integers, numbered in three ranges: the program's
+// variables first (by slot, as ResolvedTree numbers them), then one
+// register per distinct constant, loaded before the program starts, then
+// the temporaries that hold partial results of an expression. With
+// constants in registers every operand is a register, so there is a
+// single form of each instruction.
+enum class Opcode : uint8_t {
+    MOVE,               // r[a] = r[b]
+    ADD,                // r[a] = r[b] + r[c]
+    SUB,                // r[a] = r[b] - r[c]
+    MUL,                // r[a] = r[b] * r[c]
+    DIV,                // r[a] = r[b] / r[c]
+    LESS,               // r[a] = r[b] < r[c]
+    EQUAL,              // r[a] = r[b] == r[c]
+    READ,               // r[a] = next input value
+    WRITE,              // output r[a]
+    JUMP,               // go to a
+    JUMP_IF_ZERO,       // go to a if r[b] == 0
+    JUMP_IF_NOT_LESS,   // go to a unless r[b] < r[c]
+    JUMP_IF_NOT_EQUAL,  // go to a unless r[b] == r[c]
+    HALT
+};
+
+inline const char* opcodeName(Opcode op) {
+    static const char* const names[] = {
+        "move", "add", "sub", "mul", "div", "less", "equal", "read", "write",
+        "jump", "jz", "jnl", "jne", "halt"
+    };
+    return names[(unsigned)op];
+}
+
+// One fixed-size (16-byte) instruction; unused operands are 0
+struct Instruction {
+    Opcode op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+};
+
+// A compiled program
+struct Bytecode {
+    std::vector<Instruction> code;
+    std::vector<std::string> names;    // variable registers 0 .. names.size()-1
+    std::vector<int64_t> constants;    // the registers after them
+    uint32_t tempCount = 0;            // temporaries after the constants
+
+    size_t registerCount() const { return names.size() + constants.size() + tempCount; }
+
+    // Listing with one instruction per line: address, mnemonic, operands.
+    // Variables are shown by name, constants as #value, temporaries as tN.
+    void disassemble(OutputSink& out) const {
+        out.write("; ");
+        out.writeNumber(code.size());
+        out.write(" instructions, ");
+        out.writeNumber(names.size());
+        out.write(" variables, ");
+        out.writeNumber(constants.size());
+        out.write(" constants, ");
+        out.writeNumber(tempCount);
+        out.write(" temporaries\n");
+
+        for (size_t pc = 0; pc < code.size(); pc++) {
+            const Instruction& in = code[pc];
+            std::string address = std::to_string(pc);
+            out.fill(' ', address.size() < 6 ? 6 - address.size() : 0);
+            out.write(address.data(), address.size());
+            out.write("  ");
+            const char* name = opcodeName(in.op);
+            out.write(name);
+            if (in.op == Opcode::HALT) {
+                out.put('\n');
+                continue;
+            }
+            out.fill(' ', 6 - strlen(name));
+
+            switch (in.op) {
+                case Opcode::MOVE:
+                    writeRegister(out, in.a);
+                    out.write(", ");
+                    writeRegister(out, in.b);
+                    break;
+                case Opcode::READ:
+                case Opcode::WRITE:
+                    writeRegister(out, in.a);
+                    break;
+                case Opcode::JUMP:
+                    out.writeNumber(in.a);
+                    break;
+                case Opcode::JUMP_IF_ZERO:
+                    out.writeNumber(in.a);
+                    out.write(", ");
+                    writeRegister(out, in.b);
+                    break;
+                case Opcode::JUMP_IF_NOT_LESS:
+                case Opcode::JUMP_IF_NOT_EQUAL:
+                    out.writeNumber(in.a);
+                    out.write(", ");
+                    writeRegister(out, in.b);
+                    out.write(", ");
+                    writeRegister(out, in.c);
+                    break;
+                default: // three-register arithmetic and comparisons
+                    writeRegister(out, in.a);
+                    out.write(", ");
+                    writeRegister(out, in.b);
+                    out.write(", ");
+                    writeRegister(out, in.c);
+                    break;
+            }
+            out.put('\n');
+        }
+    }
+
+private:
+    void writeRegister(OutputSink& out, uint32_t r) const {
+        if (r < names.size()) {
+            out.write(names[r].data(), names[r].size());
+        } else if (r - names.size() < constants.size()) {
+            int64_t v = constants[r - names.size()];
+            out.put('#');
+            if (v < 0) {
+                out.put('-');
+                out.writeNumber(0 - (unsigned long long)v);
+            } else {
+                out.writeNumber((unsigned long long)v);
+            }
+        } else {
+            out.put('t');
+            out.writeNumber(r - names.size() - constants.size());
+        }
+    }
+};
+
+// Compiles a syntax tree to Bytecode.
+//
+// Statements and expressions are walked with explicit stacks, like the
+// interpreter, so deep nesting does not recurse. Forward jumps of if
+// statements are emitted with a placeholder target and patched once the
+// branch is compiled; a repeat loop jumps back to its first instruction.
+// A condition that is a comparison compiles to one compare-and-branch
+// (jnl/jne) instead of a comparison into a temporary and a jz.
+//
+// Temporaries are allocated like a stack within each expression: an
+// operator's result goes into the lowest temporary its operands no longer
+// need, so an expression uses as many temporaries as its nesting depth.
+// Only the outermost operator of an assignment writes the variable, after
+// every operand has been read.
+class BytecodeCompiler {
+    typedef ResolvedTree::Op Op;
+
+    // A statement being compiled and the next step in it (as in
+    // Interpreter), with the address of the instruction to patch or, for
+    // a repeat, of the loop's first instruction
+    struct Frame {
+        NodeId id;
+        uint32_t step;
+        uint32_t mark;
+    };
+
+    struct EvalItem {
+        NodeId id;
+        bool ready;
+    };
+
+    const ResolvedTree* resolved = nullptr;
+    Bytecode* out = nullptr;
+    std::vector<uint32_t> constantRegister; // per node: register of a Number
+    uint32_t tempBase = 0;
+    std::string compileError;
+
+    std::vector<Frame> frames;
+    std::vector<EvalItem> work;
+    std::vector<uint32_t> operands;
+
+    uint32_t here() const { return (uint32_t)out->code.size(); }
+
+    uint32_t emit(Opcode op, uint32_t a, uint32_t b = 0, uint32_t c = 0) {
+        Instruction in;
+        in.op = op;
+        in.a = a;
+        in.b = b;
+        in.c = c;
+        out->code.push_back(in);
+        return here() - 1;
+    }
+
+    bool isTemp(uint32_t r) const { return r >= tempBase; }
+
+    uint32_t leafRegister(NodeId id) const {
+        return resolved->op(id) == Op::NUMBER ? constantRegister[id] : (uint32_t)resolved->operand(id);
+    }
+
+    static Opcode arithmetic(Op op) {
+        switch (op) {
+            case Op::LESS: return Opcode::LESS;
+            case Op::EQUAL: return Opcode::EQUAL;
+            case Op::ADD: return Opcode::ADD;
+            case Op::SUB: return Opcode::SUB;
+            case Op::MUL: return Opcode::MUL;
+            default: return Opcode::DIV;
+        }
+    }
+
+    // Code for the operands of the operator at 'root', leaving their
+    // registers in operands[0] and operands[1]. Temporaries from tempBase
+    // up are free.
+    void compileOperands(NodeId root) {
+        const SyntaxTree& tree = resolved->tree();
+        const ASTNode& top = tree.node(root);
+        uint32_t live = 0; // temporaries holding values on the operand stack
+        work.clear();
+        operands.clear();
+        work.push_back({tree.child(top, 1), false});
+        work.push_back({tree.child(top, 0), false});
+        while (!work.empty()) {
+            EvalItem item = work.back();
+            work.pop_back();
+            Op op = resolved->op(item.id);
+            if (ResolvedTree::isLeaf(op)) {
+                operands.push_back(leafRegister(item.id));
+            } else if (!item.ready) {
+                const ASTNode& n = tree.node(item.id);
+                work.push_back({item.id, true});
+                work.push_back({tree.child(n, 1), false});
+                work.push_back({tree.child(n, 0), false});
+            } else {
+                uint32_t right = operands.back();
+                operands.pop_back();
+                uint32_t left = operands.back();
+                operands.pop_back();
+                live -= isTemp(left) + isTemp(right);
+                uint32_t result = tempBase + live++;
+                out->tempCount = std::max(out->tempCount, live);
+                emit(arithmetic(op), result, left, right);
+                operands.push_back(result);
+            }
+        }
+    }
+
+    // Code that leaves the value of expression 'root' in 'dst'
+    void compileInto(NodeId root, uint32_t dst) {
+        Op op = resolved->op(root);
+        if (ResolvedTree::isLeaf(op)) {
+            emit(Opcode::MOVE, dst, leafRegister(root));
+            return;
+        }
+        compileOperands(root);
+        emit(arithmetic(op), dst, operands[0], operands[1]);
+    }
+
+    // Register holding the value of expression 'root', which may be a
+    // variable or constant register rather than a fresh temporary
+    uint32_t compileValue(NodeId root) {
+        if (ResolvedTree::isLeaf(resolved->op(root))) return leafRegister(root);
+        out->tempCount = std::max(out->tempCount, 1u);
+        compileInto(root, tempBase);
+        return tempBase;
+    }
+
+    // Code that jumps to 'target' when condition 'root' is false; returns
+    // the address of that jump, for patching
+    uint32_t compileBranchIfFalse(NodeId root, uint32_t target) {
+        Op op = resolved->op(root);
+        if (op == Op::LESS || op == Op::EQUAL) {
+            compileOperands(root);
+            Opcode jump = op == Op::LESS ? Opcode::JUMP_IF_NOT_LESS : Opcode::JUMP_IF_NOT_EQUAL;
+            return emit(jump, target, operands[0], operands[1]);
+        }
+        return emit(Opcode::JUMP_IF_ZERO, target, compileValue(root));
+    }
+
+    void compileStatements(NodeId sequence) {
+        const SyntaxTree& tree = resolved->tree();
+        frames.clear();
+        frames.push_back({sequence, 0, 0});
+        while (!frames.empty()) {
+            Frame& f = frames.back();
+            const ASTNode& n = tree.node(f.id);
+            switch (resolved->op(f.id)) {
+            case Op::SEQUENCE: {
+                if (f.step == n.childCount) {
+                    frames.pop_back();
+                    break;
+                }
+                NodeId id = tree.child(n, f.step++);
+                const ASTNode& s = tree.node(id);
+                switch (resolved->op(id)) {
+                    case Op::ASSIGN:
+                        compileInto(tree.child(s, 1), (uint32_t)resolved->operand(tree.child(s, 0)));
+                        break;
+                    case Op::READ:
+                        emit(Opcode::READ, (uint32_t)resolved->operand(tree.child(s, 0)));
+                        break;
+                    case Op::WRITE:
+                        emit(Opcode::WRITE, compileValue(tree.child(s, 0)));
+                        break;
+                    default: // IF or REPEAT: 'f' is invalid after the push
+                        frames.push_back({id, 0, 0});
+                        break;
+                }
+                break;
+            }
+            case Op::IF:
+                if (f.step == 0) {
+                    // Test, then the then-branch; the jump past it is patched later
+                    f.mark = compileBranchIfFalse(tree.child(n, 0), 0);
+                    f.step = 1;
+                    frames.push_back({tree.child(n, 1), 0, 0});
+                } else if (f.step == 1 && n.childCount == 3) {
+                    // The then-branch jumps over the else-branch
+                    uint32_t skip = emit(Opcode::JUMP, 0);
+                    out->code[f.mark].a = here();
+                    f.mark = skip;
+                    f.step = 2;
+                    frames.push_back({tree.child(n, 2), 0, 0});
+                } else {
+                    out->code[f.mark].a = here();
+                    frames.pop_back();
+                }
+                break;
+            default: // REPEAT: the body, then back to its start while the test is false
+                if (f.step == 0) {
+                    f.mark = here();
+                    f.step = 1;
+                    frames.push_back({tree.child(n, 0), 0, 0});
+                } else {
+                    compileBranchIfFalse(tree.child(n, 1), f.mark);
+                    frames.pop_back();
+                }
+                break;
+            }
+        }
+    }
+
+public:
+    // Compile 'tree' into 'code'; false (see error()) if the tree cannot
+    // be run
+    bool compile(const SyntaxTree& tree, Bytecode& code) {
+        ResolvedTree resolution(tree);
+        compileError = resolution.error();
+        code = Bytecode();
+        if (!compileError.empty()) return false;
+
+        // Variables keep their slots; each distinct constant gets a register
+        resolved = &resolution;
+        out = &code;
+        for (size_t slot = 0; slot < resolution.variableCount(); slot++) {
+            code.names.push_back(resolution.variableName(slot));
+        }
+        std::unordered_map<int64_t, uint32_t> constantIndex;
+        constantRegister.assign(tree.size(), 0);
+        for (NodeId id = 0; id < tree.size(); id++) {
+            if (resolution.op(id) != Op::NUMBER) continue;
+            int64_t value = resolution.operand(id);
+            auto it = constantIndex.find(value);
+            if (it == constantIndex.end()) {
+                it = constantIndex.insert(std::make_pair(value, (uint32_t)code.constants.size())).first;
+                code.constants.push_back(value);
+            }
+            constantRegister[id] = (uint32_t)code.names.size() + it->second;
+        }
+        if (code.names.size() + code.constants.size() >= UINT32_MAX / 2) {
+            compileError = "Program has too many variables and constants";
+            return false;
+        }
+        tempBase = (uint32_t)(code.names.size() + code.constants.size());
+
+        // Programs compile to about one instruction per node or fewer
+        code.code.reserve(tree.size() + 1);
+        compileStatements(tree.child(tree.node(tree.root()), 0));
+        emit(Opcode::HALT, 0);
+        resolved = nullptr;
+        out = nullptr;
+        return true;
+    }
+
+    const std::string& error() const { return compileError; }
+};
+
+#endif // TINY_BYTECODE_H
@@ -0,0 +1,380 @@
+#ifndef TINY_CACHE_H
+#define TINY_CACHE_H
+
+#include "TinyCommon.h"
+#include "TinyTokenBuffer.h"
+#include "TinyAst.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 128-bit content hash (two 64-bit lanes), 8 bytes per step. Not
+// cryptographic: it names cache entries, it does not authenticate them.
+struct ContentHash {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const ContentHash& other) const { return low == other.low && high == other.high; }
+
+    std::string hex() const {
+        char text[33];
+        snprintf(text, sizeof(text), "%016llx%016llx", (unsigned long long)high, (unsigned long long)low);
+        return text;
+    }
+};
+
+inline uint64_t hashMix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Hash 'size' bytes, continuing from 'seed' (so several buffers can be
+// hashed as one key)
+inline ContentHash hashBytes(const char* data, size_t size, ContentHash seed = ContentHash()) {
+    const uint64_t k1 = 0x87c37b91114253d5ULL;
+    const uint64_t k2 = 0x4cf5ad432745937fULL;
+    uint64_t a = seed.low ^ 0x9e3779b97f4a7c15ULL;
+    uint64_t b = seed.high ^ 0x6a09e667f3bcc909ULL;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, data + i, 8);
+        a = (a ^ (w * k1)) * k2;
+        a = (a << 31) | (a >> 33);
+        b = (b + (w ^ k2)) * k1;
+        b = (b << 27) | (b >> 37);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    a ^= hashMix(tail ^ size);
+    b ^= hashMix(tail + k1);
+
+    ContentHash h;
+    h.low = hashMix(a + b);
+    h.high = hashMix(b ^ (a * k2));
+    return h;
+}
+
+inline ContentHash hashString(const std::string& text, ContentHash seed = ContentHash()) {
+    return hashBytes(text.data(), text.size(), seed);
+}
+
+// Layout version of a cache entry, as two digits. Bump it whenever store()
+// changes what it writes: it is part of every entry's magic, so entries of
+// another layout are a miss, and of the CLI's cache keys.
+#define TINY_CACHE_FORMAT "01"
+
+// What a compile produced, in a form that can be stored and loaded again.
+// Token and node values are views; on load they point into the source
+// (which the key covers) or into the entry's own string pool.
+struct CacheEntry {
+    bool success = false;
+    bool hasTokens = false;      // false when tokens were never listed
+    TokenBuffer tokens;
+    SyntaxTree ast;
+    std::vector<std::string> errors;
+    std::string treeText;        // rendered artifacts of an accepted program
+    std::string dot;
+    std::string svg;
+    std::string pool;            // text of values outside the source
+};
+
+// On-disk compile cache: one file per key in a directory. Entries are
+// written to a temporary file and renamed into place, so concurrent
+// compiles never see a half-written entry; anything unreadable, of another
+// format, or for another source size is a miss.
+class CompileCache {
+    std::string dir;
+
+    static void putU32(std::string& out, uint32_t v) { out.append((const char*)&v, 4); }
+    static void putU64(std::string& out, uint64_t v) { out.append((const char*)&v, 8); }
+    static void putString(std::string& out, const std::string& s) {
+        putU64(out, s.size());
+        out += s;
+    }
+
+    // Bounds-checked reader over a loaded entry
+    class Reader {
+        const std::string& data;
+        size_t pos = 0;
+        bool ok = true;
+
+    public:
+        explicit Reader(const std::string& bytes) : data(bytes) {}
+
+        bool good() const { return ok; }
+        bool atEnd() const { return pos == data.size(); }
+
+        const char* take(uint64_t n) {
+            if (!ok || n > data.size() - pos) {
+                ok = false;
+                return nullptr;
+            }
+            const char* p = data.data() + pos;
+            pos += (size_t)n;
+            return p;
+        }
+        uint32_t u32() {
+            uint32_t v = 0;
+            const char* p = take(4);
+            if (p) memcpy(&v, p, 4);
+            return v;
+        }
+        uint64_t u64() {
+            uint64_t v = 0;
+            const char* p = take(8);
+            if (p) memcpy(&v, p, 8);
+            return v;
+        }
+        std::string string() {
+            uint64_t n = u64();
+            const char* p = take(n);
+            return p ? std::string(p, (size_t)n) : std::string();
+        }
+    };
+
+    static const char* magic() { return "TINYCC" TINY_CACHE_FORMAT; }
+
+    // A value as (in source?, offset, length): offsets are into the source,
+    // or into the pool for text that does not view into it
+    static void putValue(std::string& out, SourceView value, SourceView source, std::string& pool) {
+        if (value.data() >= source.data() && value.data() + value.size() <= source.data() + source.size()) {
+            out += '\1';
+            putU32(out, (uint32_t)(value.data() - source.data()));
+        } else {
+            out += '\0';
+            putU32(out, (uint32_t)pool.size());
+            pool.append(value.data(), value.size());
+        }
+        putU32(out, (uint32_t)value.size());
+    }
+
+    static bool getValue(Reader& in, SourceView source, const std::string& pool, SourceView& value) {
+        const char* where = in.take(1);
+        uint32_t offset = in.u32();
+        uint32_t length = in.u32();
+        if (!in.good()) return false;
+        const char* base = *where ? source.data() : pool.data();
+        size_t limit = *where ? source.size() : pool.size();
+        if (offset > limit || length > limit - offset) return false;
+        value = SourceView(base + offset, length);
+        return true;
+    }
+
+    static bool isExpression(const SyntaxTree& tree, NodeId id) {
+        NodeKind kind = tree.node(id).kind;
+        return kind >= NodeKind::COMPARISON_OP && kind <= NodeKind::IDENTIFIER;
+    }
+
+    static bool isStatement(const SyntaxTree& tree, NodeId id) {
+        NodeKind kind = tree.node(id).kind;
+        return kind >= NodeKind::IF_STATEMENT && kind <= NodeKind::WRITE_STATEMENT;
+    }
+
+    static bool isKind(const SyntaxTree& tree, NodeId id, NodeKind kind) { return tree.node(id).kind == kind; }
+
+    // Whether TinyParser builds a node of 'kind' with these children
+    static bool validNode(const SyntaxTree& tree, NodeKind kind, const std::vector<NodeId>& kids) {
+        size_t count = kids.size();
+        switch (kind) {
+            case NodeKind::PROGRAM:
+                return count == 1 && isKind(tree, kids[0], NodeKind::STATEMENT_SEQUENCE);
+            case NodeKind::STATEMENT_SEQUENCE:
+                if (count == 0) return false;
+                for (NodeId k : kids) {
+                    if (!isStatement(tree, k)) return false;
+                }
+                return true;
+            case NodeKind::IF_STATEMENT:
+                return (count == 2 || count == 3) && isExpression(tree, kids[0]) &&
+                       isKind(tree, kids[1], NodeKind::STATEMENT_SEQUENCE) &&
+                       (count == 2 || isKind(tree, kids[2], NodeKind::STATEMENT_SEQUENCE));
+            case NodeKind::REPEAT_STATEMENT:
+                return count == 2 && isKind(tree, kids[0], NodeKind::STATEMENT_SEQUENCE) &&
+                       isExpression(tree, kids[1]);
+            case NodeKind::ASSIGN_STATEMENT:
+                return count == 2 && isKind(tree, kids[0], NodeKind::IDENTIFIER) && isExpression(tree, kids[1]);
+            case NodeKind::READ_STATEMENT:
+                return count == 1 && isKind(tree, kids[0], NodeKind::IDENTIFIER);
+            case NodeKind::WRITE_STATEMENT:
+                return count == 1 && isExpression(tree, kids[0]);
+            case NodeKind::COMPARISON_OP:
+            case NodeKind::ADDITIVE_OP:
+            case NodeKind::MULTIPLICATIVE_OP:
+                return count == 2 && isExpression(tree, kids[0]) && isExpression(tree, kids[1]);
+            case NodeKind::NUMBER:
+            case NodeKind::IDENTIFIER:
+                return count == 0;
+        }
+        return false;
+    }
+
+public:
+    explicit CompileCache(const std::string& directory) : dir(directory) {
+        if (!dir.empty() && dir[dir.size() - 1] != '/' && dir[dir.size() - 1] != '\\') dir += '/';
+    }
+
+    std::string pathFor(const ContentHash& key) const { return dir + key.hex() + ".tcc"; }
+
+    // Load the entry for 'key' compiled from 'source'; false on a miss.
+    // Values of the loaded tokens and tree view into 'source' and 'entry'.
+    bool load(const ContentHash& key, SourceView source, CacheEntry& entry) const {
+        std::ifstream file(pathFor(key), std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file) return false;
+        std::streamoff length = file.tellg();
+        if (length < 0) return false;
+        std::string bytes((size_t)length, '\0');
+        file.seekg(0);
+        if (!file.read(&bytes[0], length)) return false;
+
+        Reader in(bytes);
+        const char* m = in.take(8);
+        if (!m || memcmp(m, magic(), 8) != 0) return false;
+        ContentHash stored;
+        stored.low = in.u64();
+        stored.high = in.u64();
+        if (!(stored == key) || in.u64() != source.size()) return false;
+
+        entry.success = in.u32() != 0;
+        entry.pool = in.string();
+        entry.hasTokens = in.u32() != 0;
+
+        uint64_t tokenCount = in.u64();
+        entry.tokens.reset(source.data(), source.size());
+        for (uint64_t i = 0; i < tokenCount && in.good(); i++) {
+            const char* type = in.take(1);
+            uint32_t offset = in.u32();
+            uint32_t length = in.u32();
+            if (!in.good() || offset > source.size() || length > source.size() - offset) return false;
+            if ((uint8_t)*type >= (uint8_t)TokenType::END_OF_FILE) return false;
+            entry.tokens.push(Token(SourceView(source.data() + offset, length), TokenType((uint8_t)*type)));
+        }
+
+        // Nodes were stored in id order, children before parents, so
+        // adding them again rebuilds the same arrays. Each must be a node
+        // the parser builds, and together they must form one tree with a
+        // Program at the root, or the entry is a miss: the printers and
+        // engines that walk the tree trust its shape.
+        uint64_t nodeCount = in.u64();
+        entry.ast.clear();
+        std::vector<NodeId> kids;
+        std::vector<bool> hasParent;
+        for (uint64_t i = 0; i < nodeCount && in.good(); i++) {
+            const char* kind = in.take(1);
+            SourceView value;
+            if (!getValue(in, source, entry.pool, value)) return false;
+            uint32_t count = in.u32();
+            const char* ids = in.take((uint64_t)count * 4);
+            if (!ids || (uint8_t)*kind > (uint8_t)NodeKind::IDENTIFIER) return false;
+            kids.resize(count);
+            memcpy(kids.data(), ids, (size_t)count * 4);
+            for (NodeId k : kids) {
+                if (k >= i || hasParent[k]) return false;
+                hasParent[k] = true;
+            }
+            if (!validNode(entry.ast, NodeKind((uint8_t)*kind), kids)) return false;
+            entry.ast.addNode(NodeKind((uint8_t)*kind), value, kids.data(), count);
+            hasParent.push_back(false);
+        }
+        if (in.good() && nodeCount > 0) {
+            for (uint64_t i = 0; i + 1 < nodeCount; i++) {
+                if (!hasParent[i]) return false;
+            }
+            if (entry.ast.node(entry.ast.root()).kind != NodeKind::PROGRAM) return false;
+        }
+
+        uint32_t errorCount = in.u32();
+        entry.errors.clear();
+        for (uint32_t i = 0; i < errorCount && in.good(); i++) entry.errors.push_back(in.string());
+        entry.treeText = in.string();
+        entry.dot = in.string();
+        entry.svg = in.string();
+        return in.good() && in.atEnd();
+    }
+
+    // Store 'entry' for 'key'. Its tokens must view into 'source' (as
+    // scanned tokens do); tree values may also view into static text.
+    // Returns false if it could not be written (the cache is only an
+    // optimization).
+    bool store(const ContentHash& key, SourceView source, const CacheEntry& entry) const {
+        std::string pool;
+        std::string body;
+        putU32(body, entry.hasTokens ? 1 : 0);
+        putU64(body, entry.tokens.size());
+        for (size_t i = 0; i < entry.tokens.size(); i++) {
+            SourceView value = entry.tokens.value(i);
+            if (value.data() < source.data() || value.data() + value.size() > source.data() + source.size()) {
+                return false;
+            }
+            body += (char)(uint8_t)entry.tokens.type(i);
+            putU32(body, (uint32_t)(value.data() - source.data()));
+            putU32(body, (uint32_t)value.size());
+        }
+        putU64(body, entry.ast.size());
+        for (NodeId id = 0; id < entry.ast.size(); id++) {
+            const ASTNode& n = entry.ast.node(id);
+            body += (char)(uint8_t)n.kind;
+            putValue(body, n.value, source, pool);
+            putU32(body, n.childCount);
+            for (uint32_t i = 0; i < n.childCount; i++) putU32(body, entry.ast.child(n, i));
+        }
+        putU32(body, (uint32_t)entry.errors.size());
+        for (const auto& e : entry.errors) putString(body, e);
+        putString(body, entry.treeText);
+        putString(body, entry.dot);
+        putString(body, entry.svg);
+
+        std::string head(magic(), 8);
+        putU64(head, key.low);
+        putU64(head, key.high);
+        putU64(head, source.size());
+        putU32(head, entry.success ? 1 : 0);
+        putString(head, pool);
+
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+        int pid = _getpid();
+#else
+        mkdir(dir.c_str(), 0777);
+        int pid = (int)getpid();
+#endif
+        std::string path = pathFor(key);
+        std::string temp = path + "." + std::to_string(pid) + ".tmp";
+        {
+            std::ofstream file(temp, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file) return false;
+            file.write(head.data(), (std::streamsize)head.size());
+            file.write(body.data(), (std::streamsize)body.size());
+            if (!file) {
+                file.close();
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+#ifdef _WIN32
+        std::remove(path.c_str()); // rename() does not replace on Windows
+#endif
+        if (std::rename(temp.c_str(), path.c_str()) != 0) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // TINY_CACHE_H
@@ -2,8 +2,10 @@
 #define TINY_COMMON_H
 
 #include <string>
-#include <unordered_map>
-#include <map>
+#include <ostream>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
 
 enum class TokenType {
     SEMICOLON, IF, THEN, ELSE, END, REPEAT, UNTIL,
@@ -13,12 +15,71 @@ enum class TokenType {
     UNKNOWN, END_OF_FILE
 };
 
+// Non-owning view of a run of characters in a source buffer.
+// The buffer must outlive every view into it.
+class SourceView {
+    const char* ptr;
+    size_t len;
+
+public:
+    SourceView() : ptr(""), len(0) {}
+    SourceView(const char* p, size_t n) : ptr(p), len(n) {}
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    // Materialize an owned copy of the viewed characters
+    std::string str() const { return std::string(ptr, len); }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const SourceView& v) {
+    return os.write(v.data(), v.size());
+}
+
+// Length of the UTF-8 byte order mark at the start of a buffer (3 or 0)
+inline size_t bomLength(const char* s, size_t n) {
+    return (n >= 3 &&
+            (unsigned char)s[0] == 0xEF &&
+            (unsigned char)s[1] == 0xBB &&
+            (unsigned char)s[2] == 0xBF) ? 3 : 0;
+}
+
 struct Token {
-    std::string value;
+    SourceView value;   // points into the buffer the token was scanned from
     TokenType type;
     
-    Token(const std::string& val, TokenType t) : value(val), type(t) {}
-    Token() : value(""), type(TokenType::UNKNOWN) {}
+    Token(SourceView val, TokenType t) : value(val), type(t) {}
+    Token() : value(), type(TokenType::UNKNOWN) {}
+
+    // Owned copy of the token text, for callers that outlive the source buffer
+    std::string text() const { return value.str(); }
+};
+
+// Pull interface for anything that produces tokens on demand (scanners,
+// token lists), so the parser can consume tokens as they are scanned.
+class TokenSource {
+public:
+    virtual ~TokenSource() = default;
+
+    // Next token; END_OF_FILE once the input is exhausted, and on every call after
+    virtual Token nextToken() = 0;
+};
+
+// TokenSource over an existing array of tokens. An END_OF_FILE token in the
+// array ends the input early.
+class TokenListSource : public TokenSource {
+    const Token* tokens;
+    size_t count;
+    size_t index = 0;
+
+public:
+    TokenListSource(const Token* list, size_t n) : tokens(list), count(n) {}
+
+    Token nextToken() override {
+        if (index < count) return tokens[index++];
+        return {SourceView(), TokenType::END_OF_FILE};
+    }
 };
 
 inline std::string tokenTypeToString(TokenType t) {
@@ -48,50 +109,124 @@ inline std::string tokenTypeToString(TokenType t) {
     }
 }
 
-inline TokenType stringToTokenType(const std::string& typeStr) {
-    static std::map<std::string, TokenType> typeMap = {
-        {"SEMICOLON", TokenType::SEMICOLON},
-        {"IF", TokenType::IF},
-        {"THEN", TokenType::THEN},
-        {"ELSE", TokenType::ELSE},
-        {"END", TokenType::END},
-        {"REPEAT", TokenType::REPEAT},
-        {"UNTIL", TokenType::UNTIL},
-        {"Identifier", TokenType::IDENTIFIER},
-        {"IDENTIFIER", TokenType::IDENTIFIER},
-        {"assign", TokenType::ASSIGN},
-        {"ASSIGN", TokenType::ASSIGN},
-        {"READ", TokenType::READ},
-        {"WRITE", TokenType::WRITE},
-        {"LESSTHAN", TokenType::LESSTHAN},
-        {"EQUAL", TokenType::EQUAL},
-        {"PLUS", TokenType::PLUS},
-        {"MINUS", TokenType::MINUS},
-        {"MULT", TokenType::MUL},
-        {"MUL", TokenType::MUL},
-        {"DIV", TokenType::DIV},
-        {"OPENBRACKET", TokenType::OPENBRACKET},
-        {"CLOSEDBRACKET", TokenType::CLOSEDBRACKET},
-        {"number", TokenType::NUMBER},
-        {"NUMBER", TokenType::NUMBER}
-    };
-    
-    auto it = typeMap.find(typeStr);
-    if (it != typeMap.end()) {
-        return it->second;
+// ASCII-only lowercase, so keyword matching never depends on the C locale
+constexpr char asciiLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+// Switch key for keyword lookup: word length and lowercased first letter
+constexpr unsigned keywordKey(size_t n, char first) {
+    return unsigned(n) << 8 | (unsigned char)first;
+}
+
+// Case-insensitive compare of n source bytes against a lowercase keyword
+inline bool matchesKeyword(const char* s, const char* kw, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (asciiLower(s[i]) != kw[i]) return false;
+    }
+    return true;
+}
+
+// Classify a scanned word as a keyword or IDENTIFIER, in place on the
+// source bytes. Length plus first letter is a perfect hash over the TINY
+// keywords, so at most one candidate is ever compared.
+inline TokenType lookupKeyword(const char* s, size_t n) {
+    if (n < 2 || n > 6) return TokenType::IDENTIFIER;
+
+    const char* kw;
+    TokenType type;
+    switch (keywordKey(n, asciiLower(s[0]))) {
+        case keywordKey(2, 'i'): kw = "if";     type = TokenType::IF;     break;
+        case keywordKey(3, 'e'): kw = "end";    type = TokenType::END;    break;
+        case keywordKey(4, 't'): kw = "then";   type = TokenType::THEN;   break;
+        case keywordKey(4, 'e'): kw = "else";   type = TokenType::ELSE;   break;
+        case keywordKey(4, 'r'): kw = "read";   type = TokenType::READ;   break;
+        case keywordKey(5, 'u'): kw = "until";  type = TokenType::UNTIL;  break;
+        case keywordKey(5, 'w'): kw = "write";  type = TokenType::WRITE;  break;
+        case keywordKey(6, 'r'): kw = "repeat"; type = TokenType::REPEAT; break;
+        default: return TokenType::IDENTIFIER;
     }
-    return TokenType::UNKNOWN;
+    return matchesKeyword(s + 1, kw + 1, n - 1) ? type : TokenType::IDENTIFIER;
 }
 
-static std::unordered_map<std::string, TokenType> keywords = {
-    {"if", TokenType::IF},
-    {"then", TokenType::THEN},
-    {"else", TokenType::ELSE},
-    {"end", TokenType::END},
-    {"repeat", TokenType::REPEAT},
-    {"until", TokenType::UNTIL},
-    {"read", TokenType::READ},
-    {"write", TokenType::WRITE}
+// Type names as tokenTypeToString() writes them, plus the upper-case
+// aliases IDENTIFIER, ASSIGN, MUL and NUMBER, in a table indexed by a hash
+// of length, first and last character. The hash has no collisions among
+// these names, so a lookup is one slot and one compare with no branching
+// on the name (a switch over token types mispredicts on real dumps).
+struct TypeNameTable {
+    struct Slot {
+        char name[16];    // zero-padded
+        uint8_t length;
+        TokenType type;
+    };
+    Slot slots[128];
+
+    static unsigned hash(const char* s, size_t n) {
+        return (unsigned)(n * 11 + (unsigned char)s[0] + (unsigned char)s[n - 1]) & 127;
+    }
+
+    TypeNameTable() : slots() {
+        static const struct { const char* name; TokenType type; } names[] = {
+            {"SEMICOLON", TokenType::SEMICOLON}, {"IF", TokenType::IF}, {"THEN", TokenType::THEN},
+            {"ELSE", TokenType::ELSE}, {"END", TokenType::END}, {"REPEAT", TokenType::REPEAT},
+            {"UNTIL", TokenType::UNTIL}, {"Identifier", TokenType::IDENTIFIER},
+            {"IDENTIFIER", TokenType::IDENTIFIER}, {"assign", TokenType::ASSIGN},
+            {"ASSIGN", TokenType::ASSIGN}, {"READ", TokenType::READ}, {"WRITE", TokenType::WRITE},
+            {"LESSTHAN", TokenType::LESSTHAN}, {"EQUAL", TokenType::EQUAL}, {"PLUS", TokenType::PLUS},
+            {"MINUS", TokenType::MINUS}, {"MULT", TokenType::MUL}, {"MUL", TokenType::MUL},
+            {"DIV", TokenType::DIV}, {"OPENBRACKET", TokenType::OPENBRACKET},
+            {"CLOSEDBRACKET", TokenType::CLOSEDBRACKET}, {"number", TokenType::NUMBER},
+            {"NUMBER", TokenType::NUMBER}, {"UNKNOWN", TokenType::UNKNOWN},
+        };
+        for (const auto& entry : names) {
+            size_t n = strlen(entry.name);
+            Slot& slot = slots[hash(entry.name, n)];
+            memcpy(slot.name, entry.name, n);
+            slot.length = (uint8_t)n;
+            slot.type = entry.type;
+        }
+    }
 };
 
+inline const TypeNameTable& typeNameTable() {
+    static const TypeNameTable table;
+    return table;
+}
+
+// Token type for a type name; false if it is not one of the names above
+inline bool tokenTypeFromName(const char* s, size_t n, TokenType& type) {
+    if (n < 2 || n >= sizeof(TypeNameTable::Slot().name)) return false;
+    const TypeNameTable::Slot& slot = typeNameTable().slots[TypeNameTable::hash(s, n)];
+    if (slot.length != n || memcmp(slot.name, s, n) != 0) return false;
+    type = slot.type;
+    return true;
+}
+
+// The same for a name with at least 16 readable bytes from 's' (whatever
+// follows it): the compare is two masked 8-byte words instead of a memcmp
+// call, which is most of the lookup on short names
+inline bool tokenTypeFromNameIn16(const char* s, size_t n, TokenType& type) {
+    // keep[16 - n ..] starts with n bytes of 0xFF
+    static const unsigned char keep[32] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+    };
+    if (n < 2 || n >= sizeof(TypeNameTable::Slot().name)) return false;
+    const TypeNameTable::Slot& slot = typeNameTable().slots[TypeNameTable::hash(s, n)];
+    uint64_t word[2], mask[2], want[2];
+    memcpy(word, s, 16);
+    memcpy(mask, keep + 16 - n, 16);
+    memcpy(want, slot.name, 16);
+    if (slot.length != n || (((word[0] & mask[0]) ^ want[0]) | ((word[1] & mask[1]) ^ want[1])) != 0) {
+        return false;
+    }
+    type = slot.type;
+    return true;
+}
+
+inline TokenType stringToTokenType(const std::string& typeStr) {
+    TokenType type;
+    return tokenTypeFromName(typeStr.data(), typeStr.size(), type) ? type : TokenType::UNKNOWN;
+}
+
 #endif // TINY_COMMON_H
@@ -0,0 +1,459 @@
+#ifndef TINY_INCREMENTAL_H
+#define TINY_INCREMENTAL_H
+
+#include "TinyCommon.h"
+#include "TinyScanner.h"
+#include "TinyAst.h"
+#include "TinyParser.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+// One text edit: 'removed' bytes at 'offset' replaced by 'inserted'
+struct TextEdit {
+    size_t offset = 0;
+    size_t removed = 0;
+    std::string inserted;
+};
+
+// The single edit turning 'before' into 'after': everything between their
+// common prefix and common suffix
+inline TextEdit findEdit(const std::string& before, const std::string& after) {
+    size_t prefix = 0;
+    size_t shorter = before.size() < after.size() ? before.size() : after.size();
+    while (prefix < shorter && before[prefix] == after[prefix]) prefix++;
+    size_t suffix = 0;
+    while (suffix < shorter - prefix &&
+           before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) {
+        suffix++;
+    }
+    TextEdit edit;
+    edit.offset = prefix;
+    edit.removed = before.size() - prefix - suffix;
+    edit.inserted = after.substr(prefix, after.size() - prefix - suffix);
+    return edit;
+}
+
+// Scanner and parser state for a document that is edited in place, e.g. the
+// GUI editor. After an edit only the damaged top-level statements are
+// scanned and parsed again; the tokens and subtrees of all others are kept.
+//
+// The document is held as a list of segments, cut just past every ';' token
+// at nesting depth 0 (see ParallelParser), so each segment is one top-level
+// statement plus the whitespace and comments before it. The scanner is
+// outside any comment at a cut, so a segment scans the same on its own as
+// in the whole text. Each segment owns its text, its tokens (views into
+// that text) and the Program tree of its statement, so an edit elsewhere
+// moves none of them.
+//
+// An edit re-scans from the start of the segment it begins in, and carries
+// on through the following segments until a new cut lands on an old one
+// (an unclosed '{' or IF can make that the end of the document). Only the
+// segments in between are replaced and parsed again. The cost is that of
+// the damaged statements plus O(log n) to find them; only an edit that
+// adds or removes statements also moves the n segment pointers. While the
+// document has errors, the failing statements and their neighbours are
+// parsed again as well (see updateResult()).
+//
+// When every segment parses on its own, tree() is the tree TinyParser would
+// build for the whole text. Otherwise each run of failing segments is parsed
+// again together with the segment before and after it, and errors() lists
+// what those parses report, in document order: the errors TinyParser gives
+// for the whole text, without parsing the statements that are fine.
+class IncrementalParser {
+    struct Segment {
+        std::string text;
+        std::vector<Token> tokens;   // views into 'text'
+        SyntaxTree tree;             // Program tree of the statement, if ok
+        bool ok = false;             // parses on its own
+    };
+
+    // TokenSource over the tokens of segments 'begin' .. 'end' - 1 in order,
+    // taking only the first 'lastCount' tokens of the last one
+    class SegmentTokenSource : public TokenSource {
+        const std::vector<std::unique_ptr<Segment>>& segments;
+        size_t segment;
+        size_t end;
+        size_t lastCount;
+        size_t index = 0;
+
+    public:
+        SegmentTokenSource(const std::vector<std::unique_ptr<Segment>>& list, size_t begin, size_t endSegment,
+                           size_t lastTokens)
+            : segments(list), segment(begin), end(endSegment), lastCount(lastTokens) {}
+
+        Token nextToken() override {
+            while (segment < end) {
+                const std::vector<Token>& tokens = segments[segment]->tokens;
+                size_t count = segment + 1 == end ? lastCount : tokens.size();
+                if (index < count) return tokens[index++];
+                segment++;
+                index = 0;
+            }
+            return {SourceView(), TokenType::END_OF_FILE};
+        }
+    };
+
+    static size_t textLength(const Segment& seg) { return seg.text.size(); }
+    static size_t failCount(const Segment& seg) { return seg.ok ? 0 : 1; }
+
+    // Prefix sums of a per-segment count (a Fenwick tree): of segment
+    // lengths, so the segment an offset falls in is found in O(log n), and
+    // of failing segments, so the next one is. Rebuilt only when the number
+    // of segments changes.
+    class SegmentSums {
+        std::vector<size_t> sums; // sums[i] covers the segments (i & (i + 1)) .. i
+        size_t (*weight)(const Segment&);
+
+    public:
+        explicit SegmentSums(size_t (*counted)(const Segment&)) : weight(counted) {}
+
+        void build(const std::vector<std::unique_ptr<Segment>>& segments) {
+            sums.assign(segments.size(), 0);
+            for (size_t i = 0; i < sums.size(); i++) {
+                sums[i] += weight(*segments[i]);
+                size_t parent = i | (i + 1);
+                if (parent < sums.size()) sums[parent] += sums[i];
+            }
+        }
+
+        void add(size_t i, size_t delta) { // delta may wrap, as a subtraction
+            for (; i < sums.size(); i |= i + 1) sums[i] += delta;
+        }
+
+        // Sum over the first 'count' segments
+        size_t prefix(size_t count) const {
+            size_t sum = 0;
+            for (; count > 0; count &= count - 1) sum += sums[count - 1];
+            return sum;
+        }
+
+        // Number of leading segments whose counts sum to at most 'offset'
+        // (less than 'offset' with 'strict'), and that sum
+        size_t countUpTo(size_t offset, bool strict, size_t& sum) const {
+            size_t count = 0;
+            sum = 0;
+            size_t step = 1;
+            while (step * 2 <= sums.size()) step *= 2;
+            for (; step > 0; step /= 2) {
+                size_t next = count + step;
+                if (next <= sums.size()) {
+                    size_t total = sum + sums[next - 1];
+                    if (strict ? total < offset : total <= offset) {
+                        count = next;
+                        sum = total;
+                    }
+                }
+            }
+            return count;
+        }
+    };
+
+    // Held by pointer: a segment's text must not move, tokens view into it
+    std::vector<std::unique_ptr<Segment>> segments;
+    SegmentSums lengths{textLength};
+    SegmentSums failures{failCount};
+    size_t length = 0;        // bytes in the document
+    size_t tokenTotal = 0;
+    size_t failing = 0;       // segments that do not parse on their own
+    bool recoverErrors = false;
+    TinyParser parser;        // reused for segment parses
+    TinyParser::ParseResult context; // parse of failing segments and neighbours
+    std::vector<std::string> errorList;
+    mutable SyntaxTree whole;      // tree(), built on demand
+    mutable bool treeBuilt = false;
+    size_t scannedBytes = 0;
+    size_t parsedStatements = 0;
+
+    static bool isCut(const Token& tok, long& depth) {
+        switch (tok.type) {
+            case TokenType::IF:
+            case TokenType::REPEAT:
+                depth++;
+                return false;
+            case TokenType::END:
+            case TokenType::UNTIL:
+                depth--;
+                return false;
+            case TokenType::SEMICOLON:
+                return depth == 0;
+            default:
+                return false;
+        }
+    }
+
+    // Scan and parse a new segment. 'first': it starts the document (and
+    // may start with a BOM); 'last': it ends the document, so it has no
+    // ';' of its own.
+    void buildSegment(Segment& seg, bool first, bool last) {
+        Scanner scanner = first ? Scanner(seg.text.data(), seg.text.size())
+                                : Scanner(seg.text.data(), seg.text.size(), 0);
+        seg.tokens = scanner.scanAll();
+
+        size_t count = seg.tokens.size();
+        if (!last) count--; // the cut ';'
+        if (count == 0) {
+            // Only the document's tail may be empty: ";;" is an error
+            seg.ok = last;
+            return;
+        }
+        TinyParser::ParseResult result;
+        parser.parse(seg.tokens.data(), count, result);
+        seg.ok = result.success;
+        if (seg.ok) seg.tree.swap(result.ast);
+    }
+
+    // Collect the errors of the failing segments. A run of them is parsed
+    // from the start of the segment before it (the parser then sees the
+    // ';' it continues from) to the end of the segment after it, without
+    // that segment's cut ';' (where the document goes on). Everything
+    // before the run parses, so the first error found is the first error of
+    // the whole text. Without error recovery that is the only one reported.
+    //
+    // With recovery the parser can come out of the run still inside an IF
+    // or REPEAT whose END or UNTIL it skipped, as it would in the whole
+    // text. The following segment parses, so then (and only then) the parse
+    // ends in "Unexpected end of input" before the end of the document; the
+    // window is widened through the next run of failing segments, which
+    // may close the statement, and parsed again.
+    void updateResult() {
+        errorList.clear();
+        if (tokenTotal == 0) {
+            errorList.push_back("Error: Empty token list");
+            return;
+        }
+        size_t i = nextFailing(0);
+        while (i < segments.size()) {
+            size_t begin = i > 0 ? i - 1 : 0;
+            size_t end = i;
+            while (true) {
+                while (end < segments.size() && !segments[end]->ok) end++;
+                if (end < segments.size()) end++;
+                size_t lastCount = segments[end - 1]->tokens.size();
+                if (end < segments.size()) lastCount--;
+
+                SegmentTokenSource source(segments, begin, end, lastCount);
+                parser.parse(source, context);
+                bool nested = recoverErrors && end < segments.size() && !context.errors.empty() &&
+                              context.errors.back() == "Parse error: Unexpected end of input";
+                if (!nested) break;
+                end = nextFailing(end);
+            }
+            errorList.insert(errorList.end(), context.errors.begin(), context.errors.end());
+            if (!recoverErrors && !errorList.empty()) break;
+            i = nextFailing(end);
+        }
+    }
+
+    // First failing segment at or after 'from', or segments.size()
+    size_t nextFailing(size_t from) const {
+        size_t sum;
+        return failures.countUpTo(failures.prefix(from), false, sum);
+    }
+
+public:
+    IncrementalParser() { load(std::string()); }
+
+    // Errors are reported as TinyParser::setErrorRecovery() would
+    void setErrorRecovery(bool on) {
+        if (on != recoverErrors) {
+            recoverErrors = on;
+            parser.setErrorRecovery(on);
+            updateResult();
+        }
+    }
+
+    // Scan and parse a whole new document
+    void load(const std::string& text) {
+        // Start from an empty document, one empty (and valid) tail segment
+        segments.clear();
+        segments.emplace_back(new Segment());
+        segments[0]->ok = true;
+        lengths.build(segments);
+        failures.build(segments);
+        length = 0;
+        tokenTotal = 0;
+        failing = 0;
+        edit(0, 0, text);
+    }
+
+    void edit(const TextEdit& change) { edit(change.offset, change.removed, change.inserted); }
+
+    // Replace 'removed' bytes at 'offset' with 'inserted'
+    void edit(size_t offset, size_t removed, const std::string& inserted) {
+        if (offset > length || removed > length - offset) {
+            throw std::out_of_range("IncrementalParser: edit outside the document");
+        }
+
+        // First damaged segment: the one 'offset' is in (an insertion at a
+        // cut goes into the later segment), and the one the removal ends in
+        size_t firstStart, lastStart;
+        size_t first = lengths.countUpTo(offset, false, firstStart);
+        if (first == segments.size()) {
+            first--; // at the very end
+            firstStart -= segments[first]->text.size();
+        }
+        size_t last = lengths.countUpTo(offset + removed, true, lastStart);
+        if (last < first) {
+            last = first;
+            lastStart = firstStart;
+        }
+
+        std::string work = segments[first]->text.substr(0, offset - firstStart);
+        work += inserted;
+        work.append(segments[last]->text, offset + removed - lastStart, std::string::npos);
+
+        // Find the new cuts. 'oldStarts[k]' is where old segment next + k
+        // starts in 'work'; more of them are appended while no cut lands on
+        // one (doubling the text each time, so a long unclosed comment is
+        // not re-scanned once per segment).
+        const size_t next = last + 1;
+        std::vector<size_t> oldStarts(1, work.size());
+        std::vector<size_t> cuts;
+        size_t segStart = 0;
+        size_t resume = segments.size(); // first old segment kept after the edit
+        bool done = false;
+        while (!done) {
+            Scanner scanner = (first == 0 && segStart == 0) ? Scanner(work.data(), work.size())
+                                                           : Scanner(work.data(), work.size(), segStart);
+            long depth = 0;
+            size_t k = 0;
+            while (true) {
+                Token tok = scanner.nextToken();
+                size_t tokStart = tok.value.data() - work.data();
+                if (tok.type == TokenType::END_OF_FILE) {
+                    size_t appended = oldStarts.size() - 1;
+                    if (tokStart < work.size()) {
+                        // A NUL byte: the scanner ignores the rest of the
+                        // document, so it all goes into this last segment
+                        for (size_t i = next + appended; i < segments.size(); i++) {
+                            work += segments[i]->text;
+                        }
+                        done = true;
+                    } else if (next + appended < segments.size()) {
+                        size_t grow = work.size() - segStart;
+                        size_t added = 0;
+                        do {
+                            work += segments[next + appended]->text;
+                            added += segments[next + appended]->text.size();
+                            appended++;
+                            oldStarts.push_back(work.size());
+                        } while (next + appended < segments.size() && added < grow);
+                    } else {
+                        done = true;
+                    }
+                    break;
+                }
+
+                if (isCut(tok, depth)) {
+                    size_t cut = tokStart + tok.value.size();
+                    cuts.push_back(cut);
+                    segStart = cut;
+                    while (k < oldStarts.size() && oldStarts[k] < cut) k++;
+                    if (k < oldStarts.size() && oldStarts[k] == cut && next + k < segments.size()) {
+                        resume = next + k;
+                        done = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Split into the new segments; without a resync the last one runs
+        // to the end of the document
+        if (resume == segments.size()) cuts.push_back(work.size());
+        std::vector<std::unique_ptr<Segment>> fresh;
+        size_t begin = 0;
+        for (size_t i = 0; i < cuts.size(); i++) {
+            std::unique_ptr<Segment> seg(new Segment());
+            seg->text.assign(work, begin, cuts[i] - begin);
+            begin = cuts[i];
+            bool isLast = resume == segments.size() && i + 1 == cuts.size();
+            buildSegment(*seg, first == 0 && i == 0, isLast);
+            fresh.push_back(std::move(seg));
+        }
+
+        for (size_t i = first; i < resume; i++) {
+            tokenTotal -= segments[i]->tokens.size();
+            if (!segments[i]->ok) failing--;
+        }
+        for (const auto& seg : fresh) {
+            tokenTotal += seg->tokens.size();
+            if (!seg->ok) failing++;
+        }
+        if (fresh.size() == resume - first) {
+            // The usual case for a small edit: same statements, new text
+            for (size_t i = 0; i < fresh.size(); i++) {
+                lengths.add(first + i, fresh[i]->text.size() - segments[first + i]->text.size());
+                failures.add(first + i, failCount(*fresh[i]) - failCount(*segments[first + i]));
+                segments[first + i] = std::move(fresh[i]);
+            }
+        } else {
+            segments.erase(segments.begin() + first, segments.begin() + resume);
+            segments.insert(segments.begin() + first,
+                            std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+            lengths.build(segments);
+            failures.build(segments);
+        }
+        length = length - removed + inserted.size();
+        treeBuilt = false;
+        scannedBytes = work.size();
+        parsedStatements = fresh.size();
+
+        updateResult();
+    }
+
+    bool success() const { return failing == 0 && tokenTotal > 0; }
+    const std::vector<std::string>& errors() const { return errorList; }
+
+    // Tree of the whole document, or an empty tree unless success(). It
+    // views into this parser's segments, so it is valid until the next
+    // edit. The first call after an edit builds it, copying every node;
+    // the edit itself does not.
+    const SyntaxTree& tree() const {
+        if (treeBuilt) return whole;
+        whole.clear();
+        treeBuilt = true;
+        if (!success()) return whole;
+        std::vector<NodeId> statements;
+        for (const auto& seg : segments) {
+            if (!seg->tree.empty()) whole.appendStatements(seg->tree, statements);
+        }
+        NodeId seq = whole.addNode(NodeKind::STATEMENT_SEQUENCE, SourceView(),
+                                   statements.data(), (uint32_t)statements.size());
+        whole.addNode(NodeKind::PROGRAM, SourceView(), &seq, 1);
+        return whole;
+    }
+
+    // Tokens of top-level statement 'index' (see statementCount()), in
+    // document order, valid until the next edit
+    const std::vector<Token>& statementTokens(size_t index) const { return segments[index]->tokens; }
+    size_t tokenCount() const { return tokenTotal; }
+
+    // All tokens in one copy, valid until the next edit
+    std::vector<Token> tokens() const {
+        std::vector<Token> all;
+        all.reserve(tokenTotal);
+        for (const auto& seg : segments) {
+            all.insert(all.end(), seg->tokens.begin(), seg->tokens.end());
+        }
+        return all;
+    }
+
+    std::string text() const {
+        std::string all;
+        all.reserve(length);
+        for (const auto& seg : segments) all += seg->text;
+        return all;
+    }
+
+    size_t size() const { return length; }
+    size_t statementCount() const { return segments.size(); }
+
+    // Work done by the last edit: bytes scanned, statements parsed
+    size_t lastScannedBytes() const { return scannedBytes; }
+    size_t lastParsedStatements() const { return parsedStatements; }
+};
+
+#endif // TINY_INCREMENTAL_H
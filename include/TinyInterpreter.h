@@ -0,0 +1,418 @@
+#ifndef TINY_INTERPRETER_H
+#define TINY_INTERPRETER_H
+
+#include "TinyCommon.h"
+#include "TinyAst.h"
+#include "TinyOutput.h"
+#include <string>
+#include <vector>
+#include <istream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+// Where read statements take their values from
+class ValueInput {
+public:
+    virtual ~ValueInput() = default;
+
+    // Next value; false once the input is exhausted or not a number
+    virtual bool readValue(int64_t& value) = 0;
+};
+
+// Where write statements put theirs
+class ValueOutput {
+public:
+    virtual ~ValueOutput() = default;
+
+    virtual void writeValue(int64_t value) = 0;
+
+    // Called before every read, so a prompt-less program's output is
+    // visible before it waits for input
+    virtual void flush() {}
+};
+
+// Whitespace-separated integers from a std::istream
+class StreamValueInput : public ValueInput {
+    std::istream& in;
+
+public:
+    explicit StreamValueInput(std::istream& source) : in(source) {}
+
+    bool readValue(int64_t& value) override {
+        long long v;
+        if (!(in >> v)) return false;
+        value = (int64_t)v;
+        return true;
+    }
+};
+
+// One value per line into an OutputSink
+class SinkValueOutput : public ValueOutput {
+    OutputSink& out;
+
+public:
+    explicit SinkValueOutput(OutputSink& sink) : out(sink) {}
+
+    void writeValue(int64_t value) override {
+        if (value < 0) {
+            out.put('-');
+            out.writeNumber(0 - (unsigned long long)value);
+        } else {
+            out.writeNumber((unsigned long long)value);
+        }
+        out.put('\n');
+    }
+
+    void flush() override { out.flush(); }
+};
+
+// A syntax tree checked and resolved for execution: every node gets an
+// opcode, every Identifier a dense slot index and every Number its value,
+// so the engines that run it (Interpreter, BytecodeCompiler) never look at
+// a name or parse a digit. Node shapes are checked as well, so they can
+// trust child counts and kinds.
+class ResolvedTree {
+public:
+    enum class Op : uint8_t {
+        PROGRAM, SEQUENCE, IF, REPEAT, ASSIGN, READ, WRITE,
+        LESS, EQUAL, ADD, SUB, MUL, DIV, NUMBER, VARIABLE
+    };
+
+    static bool isExpression(Op op) { return op >= Op::LESS; }
+    static bool isStatement(Op op) { return op >= Op::IF && op <= Op::WRITE; }
+    static bool isLeaf(Op op) { return op >= Op::NUMBER; }
+
+private:
+    const SyntaxTree& syntaxTree;
+    std::vector<Op> ops;           // opcode per node
+    std::vector<int64_t> operands; // Number value, or Identifier slot
+    std::vector<std::string> names;
+    std::string resolveError;
+
+    bool fail(const std::string& message) {
+        if (resolveError.empty()) resolveError = message;
+        return false;
+    }
+
+    bool resolveNode(NodeId id, std::unordered_map<std::string, uint32_t>& slots) {
+        const ASTNode& n = syntaxTree.node(id);
+        const char* text = n.value.data();
+        size_t size = n.value.size();
+        Op op;
+        switch (n.kind) {
+            case NodeKind::PROGRAM: op = Op::PROGRAM; break;
+            case NodeKind::STATEMENT_SEQUENCE: op = Op::SEQUENCE; break;
+            case NodeKind::IF_STATEMENT: op = Op::IF; break;
+            case NodeKind::REPEAT_STATEMENT: op = Op::REPEAT; break;
+            case NodeKind::ASSIGN_STATEMENT: op = Op::ASSIGN; break;
+            case NodeKind::READ_STATEMENT: op = Op::READ; break;
+            case NodeKind::WRITE_STATEMENT: op = Op::WRITE; break;
+            case NodeKind::COMPARISON_OP:
+            case NodeKind::ADDITIVE_OP:
+            case NodeKind::MULTIPLICATIVE_OP:
+                if (size != 1) return fail("Unknown operator: " + n.value.str());
+                switch (text[0]) {
+                    case '<': op = Op::LESS; break;
+                    case '=': op = Op::EQUAL; break;
+                    case '+': op = Op::ADD; break;
+                    case '-': op = Op::SUB; break;
+                    case '*': op = Op::MUL; break;
+                    case '/': op = Op::DIV; break;
+                    default: return fail("Unknown operator: " + n.value.str());
+                }
+                break;
+            case NodeKind::NUMBER: {
+                uint64_t v = 0;
+                for (size_t i = 0; i < size; i++) {
+                    unsigned digit = (unsigned)(text[i] - '0');
+                    if (digit > 9 || v > ((uint64_t)INT64_MAX - digit) / 10) {
+                        return fail("Number out of range: " + n.value.str());
+                    }
+                    v = v * 10 + digit;
+                }
+                op = Op::NUMBER;
+                operands[id] = (int64_t)v;
+                break;
+            }
+            case NodeKind::IDENTIFIER: {
+                auto it = slots.insert(std::make_pair(n.value.str(), (uint32_t)names.size())).first;
+                if (it->second == names.size()) names.push_back(it->first);
+                op = Op::VARIABLE;
+                operands[id] = it->second;
+                break;
+            }
+            default:
+                return fail("Unknown node kind");
+        }
+        ops[id] = op;
+
+        // Children were resolved before their parent (nodes are stored
+        // bottom-up), so their opcodes can be checked here
+        auto kid = [&](uint32_t i) { return ops[syntaxTree.child(n, i)]; };
+        bool ok;
+        switch (op) {
+            case Op::PROGRAM: ok = n.childCount == 1 && kid(0) == Op::SEQUENCE; break;
+            case Op::SEQUENCE:
+                ok = true;
+                for (uint32_t i = 0; i < n.childCount; i++) ok = ok && isStatement(kid(i));
+                break;
+            case Op::IF:
+                ok = (n.childCount == 2 || n.childCount == 3) && isExpression(kid(0)) &&
+                     kid(1) == Op::SEQUENCE && (n.childCount == 2 || kid(2) == Op::SEQUENCE);
+                break;
+            case Op::REPEAT: ok = n.childCount == 2 && kid(0) == Op::SEQUENCE && isExpression(kid(1)); break;
+            case Op::ASSIGN: ok = n.childCount == 2 && kid(0) == Op::VARIABLE && isExpression(kid(1)); break;
+            case Op::READ: ok = n.childCount == 1 && kid(0) == Op::VARIABLE; break;
+            case Op::WRITE: ok = n.childCount == 1 && isExpression(kid(0)); break;
+            case Op::NUMBER:
+            case Op::VARIABLE: ok = n.childCount == 0; break;
+            default: ok = n.childCount == 2 && isExpression(kid(0)) && isExpression(kid(1)); break;
+        }
+        return ok || fail(std::string("Malformed ") + nodeKindToString(n.kind) + " node");
+    }
+
+public:
+    explicit ResolvedTree(const SyntaxTree& tree)
+        : syntaxTree(tree), ops(tree.size(), Op::PROGRAM), operands(tree.size(), 0) {
+        if (tree.empty()) {
+            fail("Empty syntax tree");
+            return;
+        }
+        std::unordered_map<std::string, uint32_t> slots;
+        for (NodeId id = 0; id < tree.size() && resolveError.empty(); id++) {
+            resolveNode(id, slots);
+        }
+        if (resolveError.empty() && ops[tree.root()] != Op::PROGRAM) fail("Syntax tree has no Program root");
+    }
+
+    ResolvedTree(const ResolvedTree&) = delete;
+    ResolvedTree& operator=(const ResolvedTree&) = delete;
+
+    // Empty if the tree can be run
+    const std::string& error() const { return resolveError; }
+
+    const SyntaxTree& tree() const { return syntaxTree; }
+    Op op(NodeId id) const { return ops[id]; }
+    int64_t operand(NodeId id) const { return operands[id]; }
+
+    // Variables by slot, in order of first appearance in the tree
+    size_t variableCount() const { return names.size(); }
+    const std::string& variableName(size_t slot) const { return names[slot]; }
+};
+
+// Runs a TINY program by walking the syntax tree TinyParser built.
+//
+// Values are 64-bit integers; arithmetic wraps around, division truncates
+// toward zero and a comparison is 1 or 0. Conditions are true when
+// non-zero. Variables start at 0.
+//
+// The tree is resolved once (ResolvedTree) when the interpreter is made.
+// Statements and expressions are walked with explicit stacks, so deep
+// nesting does not recurse on the native stack. This is the reference
+// engine; --run uses the faster bytecode VM (TinyVM.h).
+class Interpreter {
+public:
+    struct RunResult {
+        bool success = false;
+        std::string error;
+        uint64_t statements = 0;   // statements executed
+    };
+
+private:
+    typedef ResolvedTree::Op Op;
+
+    // A statement being run and the next step in it: the next child of a
+    // sequence, or for IF/REPEAT whether the body has run
+    struct Frame {
+        NodeId id;
+        uint32_t step;
+    };
+
+    // An expression node to visit; 'ready' once its operands are on the
+    // value stack
+    struct EvalItem {
+        NodeId id;
+        bool ready;
+    };
+
+    const SyntaxTree& tree;
+    ResolvedTree resolved;
+    std::vector<int64_t> vars;
+
+    std::vector<Frame> frames;
+    std::vector<EvalItem> work;
+    std::vector<int64_t> values;
+    std::string runError;
+
+    static int64_t wrap(uint64_t v) { return (int64_t)v; }
+
+    // Apply a binary operator; false on division by zero
+    bool apply(Op op, int64_t a, int64_t b, int64_t& r) {
+        switch (op) {
+            case Op::LESS: r = a < b; break;
+            case Op::EQUAL: r = a == b; break;
+            case Op::ADD: r = wrap((uint64_t)a + (uint64_t)b); break;
+            case Op::SUB: r = wrap((uint64_t)a - (uint64_t)b); break;
+            case Op::MUL: r = wrap((uint64_t)a * (uint64_t)b); break;
+            default:
+                if (b == 0) {
+                    runError = "Division by zero";
+                    return false;
+                }
+                r = (b == -1) ? wrap(0 - (uint64_t)a) : a / b; // INT64_MIN / -1 wraps
+                break;
+        }
+        return true;
+    }
+
+    // Value of a Number or Identifier node
+    int64_t leafValue(NodeId id) const {
+        int64_t v = resolved.operand(id);
+        return resolved.op(id) == Op::NUMBER ? v : vars[(size_t)v];
+    }
+
+    static bool isLeaf(Op op) { return ResolvedTree::isLeaf(op); }
+
+    // Value of the expression at 'root'
+    bool eval(NodeId root, int64_t& result) {
+        // Leaves and operators over two leaves need no stack
+        Op op = resolved.op(root);
+        if (isLeaf(op)) {
+            result = leafValue(root);
+            return true;
+        }
+        const ASTNode& top = tree.node(root);
+        NodeId left = tree.child(top, 0);
+        NodeId right = tree.child(top, 1);
+        if (isLeaf(resolved.op(left)) && isLeaf(resolved.op(right))) {
+            return apply(op, leafValue(left), leafValue(right), result);
+        }
+
+        work.clear();
+        values.clear();
+        work.push_back({root, false});
+        while (!work.empty()) {
+            EvalItem item = work.back();
+            work.pop_back();
+            const ASTNode& n = tree.node(item.id);
+            op = resolved.op(item.id);
+            if (isLeaf(op)) {
+                values.push_back(leafValue(item.id));
+            } else if (!item.ready) {
+                // Visit the left operand first, then the right, then apply
+                work.push_back({item.id, true});
+                work.push_back({tree.child(n, 1), false});
+                work.push_back({tree.child(n, 0), false});
+            } else {
+                int64_t b = values.back();
+                values.pop_back();
+                if (!apply(op, values.back(), b, values.back())) return false;
+            }
+        }
+        result = values.back();
+        return true;
+    }
+
+public:
+    explicit Interpreter(const SyntaxTree& syntaxTree)
+        : tree(syntaxTree), resolved(syntaxTree), vars(resolved.variableCount(), 0) {}
+
+    Interpreter(const Interpreter&) = delete;
+    Interpreter& operator=(const Interpreter&) = delete;
+
+    // Empty if the tree can be run
+    const std::string& error() const { return resolved.error(); }
+
+    // Variables by slot, with their values after the last run
+    size_t variableCount() const { return vars.size(); }
+    const std::string& variableName(size_t slot) const { return resolved.variableName(slot); }
+    int64_t variable(size_t slot) const { return vars[slot]; }
+
+    // Run the program from the start, with all variables at 0
+    RunResult run(ValueInput& input, ValueOutput& output) {
+        RunResult result;
+        if (!resolved.error().empty()) {
+            result.error = resolved.error();
+            return result;
+        }
+        std::fill(vars.begin(), vars.end(), 0);
+        runError.clear();
+        frames.clear();
+        frames.push_back({tree.child(tree.node(tree.root()), 0), 0});
+
+        uint64_t executed = 0;
+        while (!frames.empty() && runError.empty()) {
+            Frame& f = frames.back();
+            const ASTNode& n = tree.node(f.id);
+            switch (resolved.op(f.id)) {
+            case Op::SEQUENCE: {
+                if (f.step == n.childCount) {
+                    frames.pop_back();
+                    break;
+                }
+                NodeId id = tree.child(n, f.step++);
+                const ASTNode& s = tree.node(id);
+                executed++;
+                int64_t v;
+                switch (resolved.op(id)) {
+                    case Op::ASSIGN:
+                        if (eval(tree.child(s, 1), v)) vars[(size_t)resolved.operand(tree.child(s, 0))] = v;
+                        break;
+                    case Op::READ:
+                        output.flush();
+                        if (input.readValue(v)) {
+                            vars[(size_t)resolved.operand(tree.child(s, 0))] = v;
+                        } else {
+                            size_t slot = (size_t)resolved.operand(tree.child(s, 0));
+                            runError = "read " + resolved.variableName(slot) + ": no more input";
+                        }
+                        break;
+                    case Op::WRITE:
+                        if (eval(tree.child(s, 0), v)) output.writeValue(v);
+                        break;
+                    default: // IF or REPEAT: 'f' is invalid after the push
+                        frames.push_back({id, 0});
+                        break;
+                }
+                break;
+            }
+            case Op::IF: {
+                int64_t test;
+                if (f.step == 1 || !eval(tree.child(n, 0), test)) {
+                    frames.pop_back();
+                } else if (test != 0) {
+                    f.step = 1;
+                    frames.push_back({tree.child(n, 1), 0});
+                } else if (n.childCount == 3) {
+                    f.step = 1;
+                    frames.push_back({tree.child(n, 2), 0});
+                } else {
+                    frames.pop_back();
+                }
+                break;
+            }
+            default: { // REPEAT: run the body, then test
+                int64_t test;
+                if (f.step == 0) {
+                    f.step = 1;
+                    frames.push_back({tree.child(n, 0), 0});
+                } else if (!eval(tree.child(n, 1), test) || test != 0) {
+                    frames.pop_back();
+                } else {
+                    f.step = 0;
+                }
+                break;
+            }
+            }
+        }
+        output.flush();
+
+        result.statements = executed;
+        result.success = runError.empty();
+        result.error = runError;
+        return result;
+    }
+};
+
+#endif // TINY_INTERPRETER_H
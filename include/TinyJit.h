@@ -0,0 +1,433 @@
+#ifndef TINY_JIT_H
+#define TINY_JIT_H
+
+#include "TinyBytecode.h"
+#include "TinyInterpreter.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+// x86-64 hosts get a native code generator; anywhere else (or with
+// TINY_NO_JIT defined) JitProgram reports itself unsupported and callers
+// run the bytecode VM instead
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(TINY_NO_JIT)
+#define TINY_HAVE_JIT 1
+#else
+#define TINY_HAVE_JIT 0
+#endif
+
+#if TINY_HAVE_JIT
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
+
+// Native x86-64 code for a TINY program, translated from its Bytecode one
+// instruction at a time into a buffer of executable memory.
+//
+// The bytecode's registers (variables, constants, temporaries) become a
+// frame of 64-bit slots addressed from rbx, and each instruction becomes a
+// few machine instructions on rax/rcx/rdx; jumps become native branches to
+// the translated targets. read and write call back into C++ helpers with
+// the program's ValueInput and ValueOutput, using the System V calling
+// convention, or the Microsoft x64 one on Windows. The semantics are the
+// VM's, including the runtime errors; the code is mapped writable while it
+// is built and then only executable.
+class JitProgram {
+public:
+    struct RunResult {
+        bool success = false;
+        std::string error;
+    };
+
+    static bool supported() { return TINY_HAVE_JIT != 0; }
+
+private:
+    // What the generated code hands back: 0 when the program halts,
+    // otherwise why it stopped
+    enum Status : int { HALTED = 0, DIVIDE_BY_ZERO = 1, NO_INPUT = 2, IO_FAILED = 3 };
+
+    // Passed to the generated code, and by it to the I/O helpers
+    struct Context {
+        ValueInput* input;
+        ValueOutput* output;
+        int64_t* regs;
+        uint32_t failedRegister;
+    };
+
+    typedef int (*Entry)(int64_t* regs, Context* context);
+
+    std::vector<std::string> names;
+    std::vector<int64_t> constants;
+    size_t registerCount = 0;
+    void* memory = nullptr;
+    size_t memorySize = 0;     // whole pages
+    size_t nativeSize = 0;     // bytes of code in them
+    std::string compileError;
+
+    // The I/O helpers must not let an exception unwind through generated
+    // code, which has no unwind tables
+    static int readHelper(Context* context, uint32_t reg) {
+        try {
+            context->output->flush();
+            int64_t value;
+            if (!context->input->readValue(value)) {
+                context->failedRegister = reg;
+                return NO_INPUT;
+            }
+            context->regs[reg] = value;
+            return HALTED;
+        } catch (...) {
+            return IO_FAILED;
+        }
+    }
+
+    static int writeHelper(Context* context, int64_t value) {
+        try {
+            context->output->writeValue(value);
+            return HALTED;
+        } catch (...) {
+            return IO_FAILED;
+        }
+    }
+
+    // x86-64 encoder, just the forms the translation needs
+    class Assembler {
+    public:
+        enum Reg : uint8_t { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RSI = 6, RDI = 7 };
+
+        std::vector<uint8_t> bytes;
+
+        // Places a rel32 must point at once they are known: label 'label'
+        // at the 4 bytes from 'at'
+        struct Fixup {
+            size_t at;
+            size_t label;
+        };
+        std::vector<Fixup> fixups;
+        std::vector<size_t> labels;
+
+        void byte(uint8_t b) { bytes.push_back(b); }
+        void bytes2(uint8_t a, uint8_t b) { byte(a); byte(b); }
+        void bytes3(uint8_t a, uint8_t b, uint8_t c) { byte(a); byte(b); byte(c); }
+        void u32(uint32_t v) { for (int i = 0; i < 4; i++) byte((uint8_t)(v >> (8 * i))); }
+        void u64(uint64_t v) { for (int i = 0; i < 8; i++) byte((uint8_t)(v >> (8 * i))); }
+
+        // ModRM (and displacement) for 'reg' and the frame slot [rbx + 8*slot]
+        void slotOperand(uint8_t reg, uint32_t slot) {
+            uint32_t disp = slot * 8;
+            if (disp < 128) {
+                bytes2((uint8_t)(0x40 | (reg << 3) | RBX), (uint8_t)disp);
+            } else {
+                byte((uint8_t)(0x80 | (reg << 3) | RBX));
+                u32(disp);
+            }
+        }
+
+        // REX.W 'opcode' reg, [slot] (or [slot], reg)
+        void slotOp(uint8_t opcode, uint8_t reg, uint32_t slot) {
+            bytes2(0x48, opcode);
+            slotOperand(reg, slot);
+        }
+        void load(uint8_t reg, uint32_t slot) { slotOp(0x8B, reg, slot); }   // mov reg, [slot]
+
+        // rax is the working register; 'cached' is the slot it holds a
+        // copy of, if any, so a value just stored is not loaded again
+        static const uint32_t kNoSlot = UINT32_MAX;
+        uint32_t cached = kNoSlot;
+
+        void loadRax(uint32_t slot) {
+            if (cached == slot) return;
+            load(RAX, slot);
+            cached = slot;
+        }
+        void storeRax(uint32_t slot) {
+            slotOp(0x89, RAX, slot);                                      // mov [slot], rax
+            cached = slot;
+        }
+        void forget() { cached = kNoSlot; }
+
+        // jmp/jcc rel32 to a label; 'cc' is the condition code, or -1
+        void jump(int cc, size_t label) {
+            if (cc < 0) {
+                byte(0xE9);
+            } else {
+                bytes2(0x0F, (uint8_t)(0x80 | cc));
+            }
+            fixups.push_back({bytes.size(), label});
+            u32(0);
+        }
+
+        void patch() {
+            for (const Fixup& f : fixups) {
+                uint32_t rel = (uint32_t)(labels[f.label] - (f.at + 4));
+                memcpy(&bytes[f.at], &rel, 4);
+            }
+        }
+    };
+
+    // Condition codes for jcc/setcc
+    enum Cond { CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD };
+
+    // Arguments 1 and 2 of a call
+#ifdef _WIN32
+    static const uint8_t kArg1 = Assembler::RCX;
+    static const uint8_t kArg2 = Assembler::RDX;
+#else
+    static const uint8_t kArg1 = Assembler::RDI;
+    static const uint8_t kArg2 = Assembler::RSI;
+#endif
+
+    // Call the helper at 'address' with the context as its first
+    // argument, and return its status unless that is 0
+    static void callHelper(Assembler& as, uint64_t address, size_t exitLabel) {
+        as.bytes3(0x4C, 0x89, (uint8_t)(0xE0 | kArg1)); // mov arg1, r12
+        as.bytes2(0x48, 0xB8);                          // mov rax, address
+        as.u64(address);
+        as.bytes2(0xFF, 0xD0);                          // call rax
+        as.forget();
+        as.bytes2(0x85, 0xC0);                          // test eax, eax
+        as.jump(CC_NE, exitLabel);
+    }
+
+    bool fail(const std::string& message) {
+        compileError = message;
+        return false;
+    }
+
+    void release() {
+        if (!memory) return;
+#if TINY_HAVE_JIT
+#ifdef _WIN32
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, memorySize);
+#endif
+#endif
+        memory = nullptr;
+        memorySize = 0;
+        nativeSize = 0;
+    }
+
+    // Copy 'code' into fresh pages and make them executable (and no
+    // longer writable)
+    bool install(const std::vector<uint8_t>& code) {
+#if TINY_HAVE_JIT
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        size_t page = info.dwPageSize;
+#else
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+        size_t size = (code.size() + page - 1) / page * page;
+#ifdef _WIN32
+        void* pages = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (!pages) return fail("Cannot allocate memory for native code");
+        memory = pages;
+        memorySize = size;
+        memcpy(pages, code.data(), code.size());
+        DWORD previous;
+        if (!VirtualProtect(pages, size, PAGE_EXECUTE_READ, &previous)) {
+            release();
+            return fail("Cannot make native code executable");
+        }
+        FlushInstructionCache(GetCurrentProcess(), pages, size);
+#else
+        void* pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pages == MAP_FAILED) return fail("Cannot allocate memory for native code");
+        memory = pages;
+        memorySize = size;
+        memcpy(pages, code.data(), code.size());
+        if (mprotect(pages, size, PROT_READ | PROT_EXEC) != 0) {
+            release();
+            return fail("Cannot make native code executable");
+        }
+#endif
+        return true;
+#else
+        (void)code;
+        return fail("Native code is not supported on this host");
+#endif
+    }
+
+public:
+    JitProgram() = default;
+    ~JitProgram() { release(); }
+
+    JitProgram(const JitProgram&) = delete;
+    JitProgram& operator=(const JitProgram&) = delete;
+
+    // Translate 'code'; false (see error()) if this host cannot run native
+    // code or the program cannot be translated
+    bool compile(const Bytecode& code) {
+        release();
+        compileError.clear();
+        if (!supported()) return fail("Native code is not supported on this host");
+        registerCount = code.registerCount();
+        if (registerCount >= (1u << 28)) return fail("Program has too many registers for native code");
+        names = code.names;
+        constants = code.constants;
+
+        typedef Assembler A;
+        Assembler as;
+        const size_t count = code.code.size();
+        const size_t exitLabel = count;        // status in eax
+        const size_t divideLabel = count + 1;  // division by zero
+        as.labels.assign(count + 2, 0);
+        as.bytes.reserve(count * 16 + 64);
+
+        // Prologue: keep the frame in rbx and the context in r12 (both
+        // callee-saved), and leave rsp 16-byte aligned for calls, with
+        // the 32 bytes of shadow space Windows callees may use
+        as.byte(0x53);                                     // push rbx
+        as.bytes2(0x41, 0x54);                             // push r12
+        as.bytes3(0x48, 0x83, 0xEC); as.byte(40);          // sub rsp, 40
+#ifdef _WIN32
+        as.bytes3(0x48, 0x89, 0xCB);                       // mov rbx, rcx
+        as.bytes3(0x49, 0x89, 0xD4);                       // mov r12, rdx
+#else
+        as.bytes3(0x48, 0x89, 0xFB);                       // mov rbx, rdi
+        as.bytes3(0x49, 0x89, 0xF4);                       // mov r12, rsi
+#endif
+
+        // Where control can arrive from a jump, nothing is known about rax
+        std::vector<bool> target(count, false);
+        for (const Instruction& in : code.code) {
+            bool jumps = in.op == Opcode::JUMP || in.op == Opcode::JUMP_IF_ZERO ||
+                         in.op == Opcode::JUMP_IF_NOT_LESS || in.op == Opcode::JUMP_IF_NOT_EQUAL;
+            if (!jumps) continue;
+            if (in.a >= count) return fail("Jump out of the program");
+            target[in.a] = true;
+        }
+
+        for (size_t pc = 0; pc < count; pc++) {
+            const Instruction& in = code.code[pc];
+            as.labels[pc] = as.bytes.size();
+            if (target[pc]) as.forget();
+            switch (in.op) {
+                case Opcode::MOVE:
+                    as.loadRax(in.b);
+                    as.storeRax(in.a);
+                    break;
+                case Opcode::ADD:
+                case Opcode::SUB:
+                case Opcode::MUL:
+                    as.loadRax(in.b);
+                    if (in.op == Opcode::ADD) {
+                        as.slotOp(0x03, A::RAX, in.c);             // add rax, [c]
+                    } else if (in.op == Opcode::SUB) {
+                        as.slotOp(0x2B, A::RAX, in.c);             // sub rax, [c]
+                    } else {
+                        as.bytes3(0x48, 0x0F, 0xAF);               // imul rax, [c]
+                        as.slotOperand(A::RAX, in.c);
+                    }
+                    as.storeRax(in.a);
+                    break;
+                case Opcode::DIV:
+                    // rcx = divisor; -1 is a negation (so INT64_MIN / -1
+                    // wraps instead of faulting), anything else idiv
+                    as.load(A::RCX, in.c);
+                    as.bytes3(0x48, 0x85, 0xC9);                   // test rcx, rcx
+                    as.jump(CC_E, divideLabel);
+                    as.loadRax(in.b);
+                    as.bytes3(0x48, 0x83, 0xF9); as.byte(0xFF);    // cmp rcx, -1
+                    as.bytes2(0x75, 0x05);                         // jne +5
+                    as.bytes3(0x48, 0xF7, 0xD8);                   // neg rax
+                    as.bytes2(0xEB, 0x05);                         // jmp +5
+                    as.bytes2(0x48, 0x99);                         // cqo
+                    as.bytes3(0x48, 0xF7, 0xF9);                   // idiv rcx
+                    as.storeRax(in.a);
+                    break;
+                case Opcode::LESS:
+                case Opcode::EQUAL:
+                    as.load(A::RCX, in.b);
+                    as.bytes2(0x31, 0xC0);                         // xor eax, eax
+                    as.slotOp(0x3B, A::RCX, in.c);                 // cmp rcx, [c]
+                    as.bytes3(0x0F, (uint8_t)(0x90 | (in.op == Opcode::LESS ? CC_L : CC_E)), 0xC0); // setcc al
+                    as.storeRax(in.a);
+                    break;
+                case Opcode::READ:
+                    as.byte((uint8_t)(0xB8 | kArg2));              // mov arg2d, register
+                    as.u32(in.a);
+                    callHelper(as, (uint64_t)reinterpret_cast<uintptr_t>(&readHelper), exitLabel);
+                    break;
+                case Opcode::WRITE:
+                    as.load(kArg2, in.a);                          // arg2 = value
+                    callHelper(as, (uint64_t)reinterpret_cast<uintptr_t>(&writeHelper), exitLabel);
+                    break;
+                case Opcode::JUMP:
+                    as.jump(-1, in.a);
+                    break;
+                case Opcode::JUMP_IF_ZERO:
+                    as.loadRax(in.b);
+                    as.bytes3(0x48, 0x85, 0xC0);                   // test rax, rax
+                    as.jump(CC_E, in.a);
+                    break;
+                case Opcode::JUMP_IF_NOT_LESS:
+                case Opcode::JUMP_IF_NOT_EQUAL:
+                    as.loadRax(in.b);
+                    as.slotOp(0x3B, A::RAX, in.c);                 // cmp rax, [c]
+                    as.jump(in.op == Opcode::JUMP_IF_NOT_LESS ? CC_GE : CC_NE, in.a);
+                    break;
+                case Opcode::HALT:
+                    as.bytes2(0x31, 0xC0);                         // xor eax, eax
+                    as.jump(-1, exitLabel);
+                    break;
+            }
+        }
+
+        as.labels[divideLabel] = as.bytes.size();
+        as.byte(0xB8);                                             // mov eax, DIVIDE_BY_ZERO
+        as.u32(DIVIDE_BY_ZERO);
+        as.labels[exitLabel] = as.bytes.size();
+        as.bytes3(0x48, 0x83, 0xC4); as.byte(40);                  // add rsp, 40
+        as.bytes2(0x41, 0x5C);                                     // pop r12
+        as.byte(0x5B);                                             // pop rbx
+        as.byte(0xC3);                                             // ret
+
+        as.patch();
+        if (!install(as.bytes)) return false;
+        nativeSize = as.bytes.size();
+        return true;
+    }
+
+    const std::string& error() const { return compileError; }
+
+    // Bytes of native code (0 before a successful compile())
+    size_t codeSize() const { return nativeSize; }
+
+    // Run the program from the start, with all variables at 0
+    RunResult run(ValueInput& input, ValueOutput& output) {
+        RunResult result;
+        if (!memory) {
+            result.error = compileError.empty() ? "Program was not compiled" : compileError;
+            return result;
+        }
+        std::vector<int64_t> regs(registerCount, 0);
+        std::copy(constants.begin(), constants.end(), regs.begin() + names.size());
+        Context context = {&input, &output, regs.data(), 0};
+
+        Entry entry = reinterpret_cast<Entry>(memory);
+        int status = entry(regs.data(), &context);
+        output.flush();
+
+        switch (status) {
+            case HALTED: result.success = true; break;
+            case DIVIDE_BY_ZERO: result.error = "Division by zero"; break;
+            case NO_INPUT: result.error = "read " + names[context.failedRegister] + ": no more input"; break;
+            default: result.error = "Input or output failed"; break;
+        }
+        return result;
+    }
+};
+
+#endif // TINY_JIT_H
@@ -0,0 +1,403 @@
+#ifndef TINY_LAYOUT_H
+#define TINY_LAYOUT_H
+
+#include "TinyCommon.h"
+#include "TinyAst.h"
+#include "TinyOutput.h"
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+// Drawing metrics, in pixels. Text width is estimated from the character
+// count (14px Arial averages about 8px per character).
+static const double kLayoutCharWidth = 8;
+static const double kLayoutFontSize = 14;
+static const double kLayoutNodeHeight = 42;
+static const double kLayoutRankGap = 48;    // between the rows of nodes
+static const double kLayoutSiblingGap = 20; // between neighbouring nodes
+static const double kLayoutMargin = 20;
+
+// Tidy tree layout of a syntax tree, drawn the way toGraphViz() draws it:
+// Program and Statement-Sequence nodes are not drawn, the statements of a
+// sequence sit side by side on one row joined by edges, a statement links
+// to the first statement of each of its sequences and to its expressions,
+// statements are boxes and everything else ellipses.
+//
+// Positions come from Walker's algorithm in the linear-time form of
+// Buchheim, Juenger and Leipert, over the tree of drawn nodes (the
+// statements of a sequence are children of the sequence's statement).
+// Nodes are numbered breadth-first, so every node's children are a
+// consecutive range and both passes are plain loops over the node array:
+// no recursion, whatever the nesting depth.
+//
+// The layout keeps node ids into the tree (for labels), so the tree must
+// outlive it.
+class TreeLayout {
+public:
+    struct PlacedNode {
+        NodeId node;       // in the laid out tree
+        double x, y;       // centre
+        double width, height;
+        bool box;          // statement: box; otherwise ellipse
+    };
+
+    struct Edge {
+        uint32_t from, to; // indices into nodes()
+        bool sameRow;      // between statements of one sequence
+    };
+
+private:
+    enum : uint32_t { NONE = UINT32_MAX };
+
+    const SyntaxTree& tree;
+    std::vector<PlacedNode> placed;
+    std::vector<Edge> links;
+    double totalWidth = 0;
+    double totalHeight = 0;
+
+    // Layout tree, in breadth-first order. Node 0 is an invisible root
+    // whose children are the top-level statements; node v > 0 is
+    // placed[v - 1].
+    std::vector<NodeId> astOf;
+    std::vector<uint32_t> parent, firstChild, childCount, depth;
+    std::vector<double> widths, prelim, mod, shift, change;
+    std::vector<uint32_t> thread, ancestor;
+
+    uint32_t addNode(NodeId ast, uint32_t up) {
+        uint32_t v = (uint32_t)astOf.size();
+        astOf.push_back(ast);
+        parent.push_back(up);
+        firstChild.push_back(NONE);
+        childCount.push_back(0);
+        depth.push_back(up == NONE ? 0 : depth[up] + 1);
+
+        double w = 0;
+        if (ast != NONE) {
+            const ASTNode& n = tree.node(ast);
+            size_t chars = strlen(nodeKindToString(n.kind));
+            if (n.value.size() > chars) chars = n.value.size();
+            w = chars * kLayoutCharWidth + (isStatementKind(n.kind) ? 16 : 28);
+        }
+        widths.push_back(w);
+        return v;
+    }
+
+    // Children of 'v' in drawing order, given the statements of sequence
+    // nodes in place of the sequence, plus the edges to them
+    void addChildren(uint32_t v) {
+        NodeId ast = astOf[v];
+        if (ast == NONE) {
+            // The top-level statements: Program -> sequence -> statements
+            addSequence(v, tree.child(tree.node(tree.root()), 0), false);
+            return;
+        }
+        const ASTNode& n = tree.node(ast);
+        for (uint32_t i = 0; i < n.childCount; i++) {
+            NodeId c = tree.child(n, i);
+            if (tree.node(c).kind == NodeKind::STATEMENT_SEQUENCE) {
+                addSequence(v, c, true);
+            } else {
+                uint32_t w = addNode(c, v);
+                if (firstChild[v] == NONE) firstChild[v] = w;
+                childCount[v]++;
+                links.push_back(Edge{v - 1, w - 1, false});
+            }
+        }
+    }
+
+    void addSequence(uint32_t v, NodeId seq, bool linkParent) {
+        const ASTNode& s = tree.node(seq);
+        for (uint32_t i = 0; i < s.childCount; i++) {
+            uint32_t w = addNode(tree.child(s, i), v);
+            if (firstChild[v] == NONE) firstChild[v] = w;
+            childCount[v]++;
+            if (i > 0) {
+                links.push_back(Edge{w - 2, w - 1, true});
+            } else if (linkParent) {
+                links.push_back(Edge{v - 1, w - 1, false});
+            }
+        }
+    }
+
+    double distance(uint32_t left, uint32_t right) const {
+        return (widths[left] + widths[right]) / 2 + kLayoutSiblingGap;
+    }
+
+    bool hasLeftSibling(uint32_t v) const { return v != 0 && v > firstChild[parent[v]]; }
+    uint32_t nextLeft(uint32_t v) const { return childCount[v] > 0 ? firstChild[v] : thread[v]; }
+    uint32_t nextRight(uint32_t v) const {
+        return childCount[v] > 0 ? firstChild[v] + childCount[v] - 1 : thread[v];
+    }
+
+    // Shift the subtree of 'right' by 's', spreading the shift over the
+    // subtrees between it and 'left' (siblings, so ids are positions)
+    void moveSubtree(uint32_t left, uint32_t right, double s) {
+        double subtrees = (double)(right - left);
+        change[right] -= s / subtrees;
+        shift[right] += s;
+        change[left] += s / subtrees;
+        prelim[right] += s;
+        mod[right] += s;
+    }
+
+    void executeShifts(uint32_t v) {
+        double s = 0, c = 0;
+        for (uint32_t w = firstChild[v] + childCount[v]; w-- > firstChild[v];) {
+            prelim[w] += s;
+            mod[w] += s;
+            c += change[w];
+            s += shift[w] + c;
+        }
+    }
+
+    // Push the subtree of 'v' right of its left siblings' subtrees,
+    // walking the facing contours of both
+    uint32_t apportion(uint32_t v, uint32_t defaultAncestor) {
+        if (!hasLeftSibling(v)) return defaultAncestor;
+        uint32_t vip = v, vop = v, vim = v - 1, vom = firstChild[parent[v]];
+        double sip = mod[vip], sop = mod[vop], sim = mod[vim], som = mod[vom];
+        while (nextRight(vim) != NONE && nextLeft(vip) != NONE) {
+            vim = nextRight(vim);
+            vip = nextLeft(vip);
+            vom = nextLeft(vom);
+            vop = nextRight(vop);
+            ancestor[vop] = v;
+            double s = (prelim[vim] + sim) - (prelim[vip] + sip) + distance(vim, vip);
+            if (s > 0) {
+                uint32_t a = parent[ancestor[vim]] == parent[v] ? ancestor[vim] : defaultAncestor;
+                moveSubtree(a, v, s);
+                sip += s;
+                sop += s;
+            }
+            sim += mod[vim];
+            sip += mod[vip];
+            som += mod[vom];
+            sop += mod[vop];
+        }
+        if (nextRight(vim) != NONE && nextRight(vop) == NONE) {
+            thread[vop] = nextRight(vim);
+            mod[vop] += sim - sop;
+        }
+        if (nextLeft(vip) != NONE && nextLeft(vom) == NONE) {
+            thread[vom] = nextLeft(vip);
+            mod[vom] += sip - som;
+            defaultAncestor = v;
+        }
+        return defaultAncestor;
+    }
+
+    // Preliminary x of 'w' relative to its parent's subtree; its own
+    // children (if any) are already placed
+    void placeRelative(uint32_t w) {
+        double mid = 0;
+        if (childCount[w] > 0) {
+            uint32_t last = firstChild[w] + childCount[w] - 1;
+            mid = (prelim[firstChild[w]] + prelim[last]) / 2;
+        }
+        if (hasLeftSibling(w)) {
+            prelim[w] = prelim[w - 1] + distance(w - 1, w);
+            mod[w] = prelim[w] - mid;
+        } else {
+            prelim[w] = mid;
+        }
+    }
+
+    void layout() {
+        // Build the layout tree breadth-first. It has at most one node
+        // per tree node (the root stands in for Program).
+        size_t capacity = tree.size();
+        astOf.reserve(capacity);
+        parent.reserve(capacity);
+        firstChild.reserve(capacity);
+        childCount.reserve(capacity);
+        depth.reserve(capacity);
+        widths.reserve(capacity);
+        links.reserve(capacity);
+        addNode(NONE, NONE);
+        for (uint32_t v = 0; v < astOf.size(); v++) addChildren(v);
+        size_t count = astOf.size();
+
+        prelim.assign(count, 0);
+        mod.assign(count, 0);
+        shift.assign(count, 0);
+        change.assign(count, 0);
+        thread.assign(count, NONE);
+        ancestor.resize(count);
+        for (uint32_t v = 0; v < count; v++) ancestor[v] = v;
+
+        // First walk, bottom-up: a node's children all come after it, so
+        // in reverse order every subtree below a node is done when it
+        // places its children left to right
+        for (uint32_t v = (uint32_t)count; v-- > 0;) {
+            if (childCount[v] == 0) continue;
+            uint32_t defaultAncestor = firstChild[v];
+            for (uint32_t w = firstChild[v]; w < firstChild[v] + childCount[v]; w++) {
+                placeRelative(w);
+                defaultAncestor = apportion(w, defaultAncestor);
+            }
+            executeShifts(v);
+        }
+        placeRelative(0);
+
+        // Second walk, top-down: add up the modifiers of the ancestors
+        std::vector<double> x(count, 0), sum(count, 0);
+        double left = 0, right = 0;
+        uint32_t rows = 0;
+        for (uint32_t v = 0; v < count; v++) {
+            x[v] = prelim[v] + sum[v];
+            for (uint32_t w = firstChild[v]; w < firstChild[v] + childCount[v]; w++) {
+                sum[w] = sum[v] + mod[v];
+            }
+            if (v > 0) {
+                if (v == 1 || x[v] - widths[v] / 2 < left) left = x[v] - widths[v] / 2;
+                if (v == 1 || x[v] + widths[v] / 2 > right) right = x[v] + widths[v] / 2;
+                if (depth[v] > rows) rows = depth[v];
+            }
+        }
+
+        placed.resize(count - 1);
+        for (uint32_t v = 1; v < count; v++) {
+            PlacedNode& p = placed[v - 1];
+            p.node = astOf[v];
+            p.x = x[v] - left + kLayoutMargin;
+            p.y = kLayoutMargin + kLayoutNodeHeight / 2 + (depth[v] - 1) * (kLayoutNodeHeight + kLayoutRankGap);
+            p.width = widths[v];
+            p.height = kLayoutNodeHeight;
+            p.box = isStatementKind(tree.node(astOf[v]).kind);
+        }
+        totalWidth = count > 1 ? right - left + 2 * kLayoutMargin : 2 * kLayoutMargin;
+        totalHeight = 2 * kLayoutMargin + (rows > 0 ? rows * kLayoutNodeHeight + (rows - 1) * kLayoutRankGap : 0);
+
+        // Only the results are kept
+        std::vector<NodeId>().swap(astOf);
+        std::vector<uint32_t>().swap(parent);
+        std::vector<uint32_t>().swap(firstChild);
+        std::vector<uint32_t>().swap(childCount);
+        std::vector<uint32_t>().swap(depth);
+        std::vector<double>().swap(widths);
+        std::vector<double>().swap(prelim);
+        std::vector<double>().swap(mod);
+        std::vector<double>().swap(shift);
+        std::vector<double>().swap(change);
+        std::vector<uint32_t>().swap(thread);
+        std::vector<uint32_t>().swap(ancestor);
+    }
+
+    static void writeCoordinate(OutputSink& out, double value) {
+        out.writeNumber((unsigned long long)(value < 0 ? 0 : value + 0.5));
+    }
+
+    static void writeEscaped(OutputSink& out, SourceView text) {
+        const char* data = text.data();
+        for (size_t i = 0; i < text.size(); i++) {
+            switch (data[i]) {
+                case '&': out.write("&amp;", 5); break;
+                case '<': out.write("&lt;", 4); break;
+                case '>': out.write("&gt;", 4); break;
+                case '"': out.write("&quot;", 6); break;
+                default: out.put(data[i]); break;
+            }
+        }
+    }
+
+    static void writeText(OutputSink& out, double x, double y, SourceView text) {
+        out.write("<text x=\"");
+        writeCoordinate(out, x);
+        out.write("\" y=\"");
+        writeCoordinate(out, y);
+        out.write("\">");
+        writeEscaped(out, text);
+        out.write("</text>\n");
+    }
+
+public:
+    explicit TreeLayout(const SyntaxTree& syntaxTree) : tree(syntaxTree) {
+        if (!tree.empty()) layout();
+    }
+
+    const std::vector<PlacedNode>& nodes() const { return placed; }
+    const std::vector<Edge>& edges() const { return links; }
+    double width() const { return totalWidth; }
+    double height() const { return totalHeight; }
+
+    // Node text: the kind, and the token text (if any) on a second line
+    const char* kindLabel(const PlacedNode& p) const { return nodeKindToString(tree.node(p.node).kind); }
+    SourceView valueLabel(const PlacedNode& p) const { return tree.node(p.node).value; }
+
+    // Write the drawing as an SVG document
+    void writeSVG(OutputSink& out) const {
+        out.write("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+        writeCoordinate(out, totalWidth);
+        out.write("\" height=\"");
+        writeCoordinate(out, totalHeight);
+        out.write("\" font-family=\"Arial\" font-size=\"");
+        writeCoordinate(out, kLayoutFontSize);
+        out.write("\" text-anchor=\"middle\">\n");
+        out.write("<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n");
+
+        out.write("<g stroke=\"black\">\n");
+        for (const Edge& e : links) {
+            const PlacedNode& a = placed[e.from];
+            const PlacedNode& b = placed[e.to];
+            out.write("<line x1=\"");
+            if (e.sameRow) {
+                writeCoordinate(out, a.x + a.width / 2);
+                out.write("\" y1=\"");
+                writeCoordinate(out, a.y);
+                out.write("\" x2=\"");
+                writeCoordinate(out, b.x - b.width / 2);
+                out.write("\" y2=\"");
+                writeCoordinate(out, b.y);
+            } else {
+                writeCoordinate(out, a.x);
+                out.write("\" y1=\"");
+                writeCoordinate(out, a.y + a.height / 2);
+                out.write("\" x2=\"");
+                writeCoordinate(out, b.x);
+                out.write("\" y2=\"");
+                writeCoordinate(out, b.y - b.height / 2);
+            }
+            out.write("\"/>\n");
+        }
+
+        out.write("</g>\n<g stroke=\"black\" fill=\"white\">\n");
+        for (const PlacedNode& p : placed) {
+            if (p.box) {
+                out.write("<rect x=\"");
+                writeCoordinate(out, p.x - p.width / 2);
+                out.write("\" y=\"");
+                writeCoordinate(out, p.y - p.height / 2);
+                out.write("\" width=\"");
+                writeCoordinate(out, p.width);
+                out.write("\" height=\"");
+                writeCoordinate(out, p.height);
+            } else {
+                out.write("<ellipse cx=\"");
+                writeCoordinate(out, p.x);
+                out.write("\" cy=\"");
+                writeCoordinate(out, p.y);
+                out.write("\" rx=\"");
+                writeCoordinate(out, p.width / 2);
+                out.write("\" ry=\"");
+                writeCoordinate(out, p.height / 2);
+            }
+            out.write("\"/>\n");
+        }
+
+        // Baselines for one centred line, or two
+        out.write("</g>\n<g>\n");
+        for (const PlacedNode& p : placed) {
+            SourceView value = valueLabel(p);
+            const char* kind = kindLabel(p);
+            if (value.empty()) {
+                writeText(out, p.x, p.y + kLayoutFontSize / 3, SourceView(kind, strlen(kind)));
+            } else {
+                writeText(out, p.x, p.y - 2, SourceView(kind, strlen(kind)));
+                writeText(out, p.x, p.y + kLayoutFontSize, value);
+            }
+        }
+        out.write("</g>\n</svg>\n");
+    }
+};
+
+#endif // TINY_LAYOUT_H
@@ -0,0 +1,92 @@
+#ifndef TINY_MAPPED_FILE_H
+#define TINY_MAPPED_FILE_H
+
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file, so the scanner can work on the
+// mapped pages directly instead of on a copy in a std::string.
+// Throws std::runtime_error if the file cannot be opened or mapped.
+class MappedFile {
+    const char* ptr = "";
+    size_t len = 0;
+    void* view = nullptr;
+
+public:
+    explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Cannot open file: " + path);
+        }
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            throw std::runtime_error("Cannot read size of file: " + path);
+        }
+        len = (size_t)size.QuadPart;
+        if (len > 0) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL) {
+                view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open file: " + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot read size of file: " + path);
+        }
+        len = (size_t)st.st_size;
+        if (len > 0) {
+            void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                view = p;
+                madvise(view, len, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+#endif
+        if (len > 0 && view == nullptr) {
+            throw std::runtime_error("Cannot map file: " + path);
+        }
+        if (view != nullptr) ptr = static_cast<const char*>(view);
+    }
+
+    ~MappedFile() {
+        if (view == nullptr) return;
+#ifdef _WIN32
+        UnmapViewOfFile(view);
+#else
+        munmap(view, len);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+};
+
+#endif // TINY_MAPPED_FILE_H
@@ -0,0 +1,146 @@
+#ifndef TINY_OUTPUT_H
+#define TINY_OUTPUT_H
+
+#include "TinyCommon.h"
+#include <string>
+#include <ostream>
+#include <cstring>
+#include <cstddef>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Buffered byte sink for the tree printers: output is collected in a fixed
+// buffer and handed on in large blocks, so printing a tree makes no
+// per-line strings or allocations. Subclasses decide where blocks go, and
+// must call flush() in their destructor (the base class cannot).
+class OutputSink {
+    char buffer[1 << 14];
+    size_t used = 0;
+    bool ok = true;
+
+protected:
+    // Write one block; false on failure
+    virtual bool writeOut(const char* data, size_t size) = 0;
+
+public:
+    OutputSink() = default;
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+    virtual ~OutputSink() = default;
+
+    void write(const char* data, size_t size) {
+        if (size == 0) return; // 'data' may be null, e.g. an empty vector's
+        if (size > sizeof(buffer) - used) {
+            flush();
+            if (size >= sizeof(buffer)) {
+                if (ok) ok = writeOut(data, size);
+                return;
+            }
+        }
+        memcpy(buffer + used, data, size);
+        used += size;
+    }
+
+    void write(const char* text) { write(text, strlen(text)); }
+    void write(SourceView text) { write(text.data(), text.size()); }
+
+    void put(char ch) {
+        if (used == sizeof(buffer)) flush();
+        buffer[used++] = ch;
+    }
+
+    // 'count' copies of 'ch', e.g. indentation
+    void fill(char ch, size_t count) {
+        while (count > 0) {
+            if (used == sizeof(buffer)) flush();
+            size_t n = sizeof(buffer) - used < count ? sizeof(buffer) - used : count;
+            memset(buffer + used, ch, n);
+            used += n;
+            count -= n;
+        }
+    }
+
+    void writeNumber(unsigned long long value) {
+        char digits[20];
+        size_t n = 0;
+        do {
+            digits[sizeof(digits) - ++n] = char('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        write(digits + sizeof(digits) - n, n);
+    }
+
+    void flush() {
+        if (used > 0 && ok) ok = writeOut(buffer, used);
+        used = 0;
+    }
+
+    // False once a block could not be written; later output is dropped
+    bool good() const { return ok; }
+};
+
+// Sink appending to a std::string (complete after flush() or destruction)
+class StringSink : public OutputSink {
+    std::string& out;
+
+protected:
+    bool writeOut(const char* data, size_t size) override {
+        out.append(data, size);
+        return true;
+    }
+
+public:
+    explicit StringSink(std::string& target) : out(target) {}
+    ~StringSink() override { flush(); }
+};
+
+// Sink writing to a std::ostream
+class StreamSink : public OutputSink {
+    std::ostream& out;
+
+protected:
+    bool writeOut(const char* data, size_t size) override {
+        out.write(data, (std::streamsize)size);
+        return (bool)out;
+    }
+
+public:
+    explicit StreamSink(std::ostream& target) : out(target) {}
+    ~StreamSink() override { flush(); }
+};
+
+// Sink writing straight to a file descriptor (e.g. 1 for stdout), with no
+// stdio or iostream layer in between. The descriptor stays open.
+class FdSink : public OutputSink {
+    int fd;
+
+protected:
+    bool writeOut(const char* data, size_t size) override {
+        while (size > 0) {
+#ifdef _WIN32
+            int chunk = size > (1u << 30) ? (1 << 30) : (int)size;
+            int n = _write(fd, data, (unsigned)chunk);
+#else
+            ssize_t n = ::write(fd, data, size);
+#endif
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += n;
+            size -= (size_t)n;
+        }
+        return true;
+    }
+
+public:
+    explicit FdSink(int descriptor) : fd(descriptor) {}
+    ~FdSink() override { flush(); }
+};
+
+#endif // TINY_OUTPUT_H
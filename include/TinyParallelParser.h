@@ -0,0 +1,144 @@
+#ifndef TINY_PARALLEL_PARSER_H
+#define TINY_PARALLEL_PARSER_H
+
+#include "TinyCommon.h"
+#include "TinyTokenBuffer.h"
+#include "TinyAst.h"
+#include "TinyParser.h"
+#include <vector>
+#include <thread>
+
+// Parallel version of TinyParser::parse() for long programs made of many
+// top-level statements.
+//
+// A pass over the token types finds the ';' tokens at nesting depth 0
+// (IF and REPEAT open a level, END and UNTIL close it). The token list is
+// cut at some of them into one segment per thread, and each segment is
+// parsed on its own as a statement sequence. The statements of all
+// segments are then spliced into one Statement-Sequence under Program.
+//
+// A statement parses the same way whether a ';' or the end of its segment
+// follows it, so if every segment parses cleanly the spliced tree is the
+// one the serial parser builds. If any segment fails, the whole input is
+// parsed again serially, so errors (and error recovery) are exactly those
+// of TinyParser as well.
+class ParallelParser {
+    const Token* tokens = nullptr;        // token span input, or
+    const TokenBuffer* buffer = nullptr;  // structure-of-arrays input
+    size_t count;
+    bool recoverErrors = false;
+
+    TokenType typeAt(size_t i) const {
+        return tokens != nullptr ? tokens[i].type : TokenType(buffer->typeData()[i]);
+    }
+
+    void parseRange(TinyParser& parser, size_t begin, size_t end, TinyParser::ParseResult& out) const {
+        if (tokens != nullptr) {
+            TokenListSource source(tokens + begin, end - begin);
+            parser.parse(source, out);
+        } else {
+            TokenBufferSource source(*buffer, begin, end);
+            parser.parse(source, out);
+        }
+    }
+
+    TinyParser::ParseResult parseSerial() const {
+        TinyParser parser;
+        parser.setErrorRecovery(recoverErrors);
+        TinyParser::ParseResult result;
+        parseRange(parser, 0, count, result);
+        return result;
+    }
+
+    // Start of each segment: 0, then just past chosen top-level ';' tokens
+    // near every count/chunks tokens
+    std::vector<size_t> findSegments(size_t chunks) const {
+        std::vector<size_t> starts(1, 0);
+        size_t nextTarget = count / chunks;
+        long depth = 0;
+        for (size_t i = 0; i < count && starts.size() < chunks; i++) {
+            switch (typeAt(i)) {
+                case TokenType::IF:
+                case TokenType::REPEAT:
+                    depth++;
+                    break;
+                case TokenType::END:
+                case TokenType::UNTIL:
+                    depth--;
+                    break;
+                case TokenType::SEMICOLON:
+                    // Never leave a ';' at the end of a segment: a segment
+                    // accepts a trailing ';', the serial parse would not
+                    if (depth == 0 && i >= nextTarget && i + 1 < count &&
+                        i > 0 && typeAt(i - 1) != TokenType::SEMICOLON) {
+                        starts.push_back(i + 1);
+                        nextTarget = count / chunks * starts.size();
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return starts;
+    }
+
+public:
+    ParallelParser(const Token* tokenData, size_t tokenCount) : tokens(tokenData), count(tokenCount) {}
+    explicit ParallelParser(const TokenBuffer& tokenBuffer) : buffer(&tokenBuffer), count(tokenBuffer.size()) {}
+
+    // Errors are reported as TinyParser::setErrorRecovery() would
+    void setErrorRecovery(bool on) { recoverErrors = on; }
+
+    // Parse with up to 'threads' workers (0 = one per hardware thread).
+    // Inputs shorter than 'minTokens' tokens per thread use fewer threads.
+    TinyParser::ParseResult parse(unsigned threads = 0, size_t minTokens = 1 << 16) const {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (minTokens == 0) minTokens = 1;
+        size_t maxChunks = count / minTokens;
+        size_t chunks = threads < maxChunks ? threads : maxChunks;
+        if (chunks <= 1) {
+            return parseSerial();
+        }
+
+        std::vector<size_t> starts = findSegments(chunks);
+        size_t segments = starts.size();
+        if (segments <= 1) {
+            return parseSerial();
+        }
+        starts.push_back(count + 1); // segment i ends before the ';' at starts[i + 1] - 1
+
+        std::vector<TinyParser::ParseResult> parts(segments);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < segments; i++) {
+            workers.emplace_back([this, &parts, &starts, i]() {
+                TinyParser parser;
+                parseRange(parser, starts[i], starts[i + 1] - 1, parts[i]);
+            });
+        }
+        {
+            TinyParser parser;
+            parseRange(parser, starts[0], starts[1] - 1, parts[0]);
+        }
+        for (auto& w : workers) w.join();
+
+        for (const auto& part : parts) {
+            if (!part.success) return parseSerial();
+        }
+
+        // Splice: copy each segment's statements and collect them under
+        // one Statement-Sequence
+        TinyParser::ParseResult result;
+        SyntaxTree& tree = result.ast;
+        std::vector<NodeId> statements;
+        for (const auto& part : parts) {
+            tree.appendStatements(part.ast, statements);
+        }
+        NodeId seq = tree.addNode(NodeKind::STATEMENT_SEQUENCE, SourceView(),
+                                  statements.data(), (uint32_t)statements.size());
+        tree.addNode(NodeKind::PROGRAM, SourceView(), &seq, 1);
+        result.success = true;
+        return result;
+    }
+};
+
+#endif // TINY_PARALLEL_PARSER_H
@@ -0,0 +1,191 @@
+#ifndef TINY_PARALLEL_SCANNER_H
+#define TINY_PARALLEL_SCANNER_H
+
+#include "TinyCommon.h"
+#include "TinyScanner.h"
+#include "TinySimd.h"
+#include <vector>
+#include <thread>
+
+// Parallel version of Scanner::scanAll() for large in-memory buffers.
+//
+// The buffer is cut into one chunk per thread and each chunk is scanned
+// without knowing how the previous one ended. A chunk can start in one of
+// two states:
+//  - outside a comment: scan from the chunk start as usual;
+//  - inside a comment: nothing is a token until the first '}'.
+// The outside-comment scan is always between tokens right after that first
+// '}' as well (the '}' either closes a comment it saw open or is an UNKNOWN
+// token of its own), so the inside-comment result is the tail of the same
+// token list and one scan per chunk covers both states.
+//
+// A linear pass then walks the chunks in order, picks the state each chunk
+// really starts in from the previous chunk's exit state, and splices the
+// token lists. A token that runs across a chunk boundary is completed by the
+// chunk it starts in and the next chunk drops its partial copy. The result
+// is identical to the serial Scanner.
+class ParallelScanner {
+    // Scan result for one chunk [begin, end)
+    struct ChunkScan {
+        std::vector<Token> tokens;   // tokens starting in the chunk, outside-comment start
+        size_t commentResume = 0;    // first token that is valid for an inside-comment start
+        bool wholeChunkComment = false; // inside-comment start: no '}' in the chunk
+        bool commentHitsEof = false;    // inside-comment start: NUL before any '}'
+        size_t exitPos = 0;          // where the next chunk's scan must pick up
+        bool exitInComment = false;  // ... and whether that is inside a comment
+        bool hitEof = false;         // a NUL byte ended the input in this chunk
+    };
+
+    const char* input;
+    size_t len;
+    const SkipKernels* skip = &skipKernels();
+
+    size_t tokenEnd(const Token& tok) const {
+        return (size_t)(tok.value.data() - input) + tok.value.size();
+    }
+
+    size_t tokenStart(const Token& tok) const {
+        return (size_t)(tok.value.data() - input);
+    }
+
+    // Whether scanning the token-free gap [from, end) starting outside a
+    // comment leaves the scanner inside one
+    bool gapEndsInComment(size_t from, size_t end) const {
+        bool inComment = false;
+        size_t p = from;
+        while (p < end) {
+            if (inComment) {
+                p = skip->findCommentEnd(input, p, end);
+                if (p < end) { p++; inComment = false; }
+            } else {
+                p = skip->skipSpaces(input, p, end);
+                if (p < end) { p++; inComment = true; } // only '{' can follow
+            }
+        }
+        return inComment;
+    }
+
+    // Scan tokens that start in [from, end), beginning outside a comment
+    void scanRange(size_t from, size_t end, ChunkScan& out) const {
+        // Scan a view cut at 'end' so whitespace and comments past the chunk
+        // are left to the next chunk
+        Scanner scanner(input, end, from);
+        size_t lastEnd = from;
+        while (true) {
+            Token tok = scanner.nextToken();
+            if (tok.type == TokenType::END_OF_FILE) {
+                size_t stop = tokenStart(tok);
+                if (stop < end) {
+                    // NUL byte: the input ends here
+                    out.hitEof = true;
+                    out.exitPos = stop;
+                } else {
+                    out.exitPos = end;
+                    out.exitInComment = gapEndsInComment(lastEnd, end);
+                }
+                return;
+            }
+            if (tokenEnd(tok) == end && end < len) {
+                // May run past the chunk: finish it on the full buffer
+                Scanner full(input, len, tokenStart(tok));
+                tok = full.nextToken();
+                out.tokens.push_back(tok);
+                out.exitPos = tokenEnd(tok);
+                return;
+            }
+            out.tokens.push_back(tok);
+            lastEnd = tokenEnd(tok);
+        }
+    }
+
+    void scanChunk(size_t begin, size_t end, ChunkScan& out) const {
+        scanRange(begin, end, out);
+
+        size_t close = skip->findCommentEnd(input, begin, end);
+        if (close == end) {
+            out.wholeChunkComment = true;
+        } else if (input[close] == '\0') {
+            out.commentHitsEof = true;
+        } else {
+            size_t k = 0;
+            while (k < out.tokens.size() && tokenStart(out.tokens[k]) <= close) k++;
+            out.commentResume = k;
+        }
+    }
+
+public:
+    ParallelScanner(const char* data, size_t size) : input(data), len(size) {}
+
+    // Scan with up to 'threads' workers (0 = one per hardware thread).
+    // Inputs shorter than 'minChunk' bytes per thread use fewer threads.
+    std::vector<Token> scanAll(unsigned threads = 0, size_t minChunk = 1 << 20) {
+        size_t begin = bomLength(input, len);
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (minChunk == 0) minChunk = 1;
+        size_t maxChunks = (len - begin) / minChunk;
+        size_t chunks = threads < maxChunks ? threads : maxChunks;
+        if (chunks <= 1) {
+            return Scanner(input, len).scanAll();
+        }
+
+        std::vector<size_t> bounds(chunks + 1);
+        for (size_t i = 0; i <= chunks; i++) {
+            bounds[i] = begin + (len - begin) / chunks * i;
+        }
+        bounds[chunks] = len;
+
+        std::vector<ChunkScan> scans(chunks);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < chunks; i++) {
+            workers.emplace_back([this, &scans, &bounds, i]() {
+                scanChunk(bounds[i], bounds[i + 1], scans[i]);
+            });
+        }
+        scanRange(bounds[0], bounds[1], scans[0]);
+        for (auto& w : workers) w.join();
+
+        // Fix-up pass: follow the real state from chunk to chunk
+        std::vector<Token> tokens;
+        size_t total = 0;
+        for (const auto& scan : scans) total += scan.tokens.size();
+        tokens.reserve(total);
+
+        size_t pos = bounds[0];
+        bool inComment = false;
+        for (size_t i = 0; i < chunks; i++) {
+            ChunkScan& scan = scans[i];
+            size_t first = 0;
+
+            if (pos > bounds[i]) {
+                // The previous chunk's last token ran into this one. The scan
+                // from the chunk start is back in step if one of its tokens
+                // ends exactly there; otherwise rescan the rest of the chunk.
+                // (With today's tokens the tail of a token always scans as
+                // one token, so the rescan is a safeguard for new ones.)
+                while (first < scan.tokens.size() && tokenStart(scan.tokens[first]) < pos) first++;
+                if (first == 0 || tokenEnd(scan.tokens[first - 1]) != pos) {
+                    if (pos >= bounds[i + 1]) continue; // the token covered this whole chunk
+                    ChunkScan redo;
+                    scanRange(pos, bounds[i + 1], redo);
+                    scan = redo;
+                    first = 0;
+                }
+            } else if (inComment) {
+                if (scan.commentHitsEof) break;
+                if (scan.wholeChunkComment) {
+                    pos = bounds[i + 1];
+                    continue;
+                }
+                first = scan.commentResume;
+            }
+
+            tokens.insert(tokens.end(), scan.tokens.begin() + first, scan.tokens.end());
+            if (scan.hitEof) break;
+            pos = scan.exitPos;
+            inComment = scan.exitInComment;
+        }
+        return tokens;
+    }
+};
+
+#endif // TINY_PARALLEL_SCANNER_H
@@ -2,411 +2,461 @@
 #define TINY_PARSER_H
 
 #include "TinyCommon.h"
+#include "TinyTokenBuffer.h"
+#include "TinyAst.h"
+#include "TinyLayout.h"
+#include "TinyTokenFile.h"
+#include "TinyTokenText.h"
 #include <string>
 #include <vector>
-#include <memory>
 #include <stdexcept>
 #include <sstream>
 #include <fstream>
 #include <cstdlib>
-
-// AST Node base class
-class ASTNode {
-public:
-    std::string nodeType;
-    std::vector<std::shared_ptr<ASTNode>> children;
-    std::string value;
-    int nodenum=-1;
-
-
-    ASTNode(const std::string& type) : nodeType(type), value("") {}
-    ASTNode(const std::string& type, const std::string& val) : nodeType(type), value(val) {}
-
-    virtual ~ASTNode() = default;
-
-    void addChild(std::shared_ptr<ASTNode> child) {
-        if (child != nullptr) {
-            children.push_back(child);
-        }
-    }
-
-    std::string toString(int level = 0) const {
-        std::string indent(level * 2, ' ');
-        std::string result = indent + nodeType;
-        if (!value.empty()) {
-            result += " (" + value + ")";
-        }
-        result += "\n";
-
-        for (const auto& child : children) {
-            result += child->toString(level + 1);
-        }
-        return result;
-    }
-
-    // Generate GraphViz DOT format for visualization
-    std::string toDot(int& nodeCounter)  {
-        int myId = nodeCounter;
-        nodenum = myId;
-        int flag=0;
-        std::string result;
-
-        // Create node label
-        std::string label = nodeType;
-        if (!value.empty()) {
-            label += "\\n" + value;
-        }
-
-        // Escape special characters in label
-        size_t pos = 0;
-        while ((pos = label.find("\"", pos)) != std::string::npos) {
-            label.replace(pos, 1, "\\\"");
-            pos += 2;
-        }
-
-        // Decide shape
-        std::string shape = "ellipse";
-        if (nodeType.find("Statement") != std::string::npos || nodeType == "Program") {
-            shape = "box";
-        }
-
-        // Add node with proper shape
-        if(nodeType.find("Sequence") == -1 && nodeType.find("Program") == -1) {
-            flag=1;
-            nodeCounter++;
-
-            result += "  node" + std::to_string(myId) + " [shape=" + shape + ", fontname=\"Arial\", label=\"" + label + "\"];\n";
-        }
-
-        std::shared_ptr<ASTNode> firstchild = nullptr;
-        int firstChildId=-1;
-        // Add edges to children
-        for (const auto& child : children) {
-            int childStartId = nodeCounter;
-            if(firstChildId == -1 && (child->nodeType).find("Statement") !=-1 ) {
-                firstchild = child;
-                firstChildId = childStartId;
-            }
-            result += child->toDot(nodeCounter);
-            if(flag) {
-                if((child->nodeType).find("Statement") !=-1) {
-                    if(firstchild == child)
-                        result += "  node" + std::to_string(myId) + " -- node" + std::to_string(childStartId) + ";\n";
-                    else {
-                        if(this->nodeType == "If-Statement" && children.size()>2 && child==children.back()) {
-                            result += "  node" + std::to_string(myId) + " -- node" + std::to_string(childStartId) + ";\n";
-                        }else {
-                            result += "  node" + std::to_string(firstChildId) + " -- node" + std::to_string(childStartId) + ";\n";
-                            result += " { rank = same; node" + std::to_string(firstChildId) + " ; node" + std::to_string(childStartId) + ";}\n";
-                        }
-
-                    }
-                }else {
-                    result += "  node" + std::to_string(myId) + " -- node" + std::to_string(childStartId) + ";\n";
-                    
-                }
-            }
-        }
-        if(nodeType.find("Sequence") != -1) {
-            for (int i=1; i<children.size(); i++) {
-                result += "  node" + std::to_string(children[i-1]->nodenum) + " -- node" + std::to_string(children[i]->nodenum) + ";\n";
-            }
-            result += " subgraph sub"+std::to_string(myId++) +" { ";
-            result+= "rank = same;" ;
-            for (int i=0; i<children.size(); i++) {
-                result += " node" + std::to_string(children[i]->nodenum) + " ; " ;
-            }
-            result +="}\n";
-        }
-        if(nodeType.find("If") != -1) {
-            result += "  node" + std::to_string(children[0]->nodenum) + " -- node" + std::to_string(children[1]->nodenum) + "[style=invis];\n";
-            result += " { rank = same; node" + std::to_string(children[0]->nodenum) + " ; node" + std::to_string(children[1]->nodenum) + ";}\n";
-        }
-        if(nodeType.find("Repeat") != -1) {
-            result += "  node" + std::to_string((children[children.size()-2]->children)[((children[children.size()-2])->children.size())-1]->nodenum) + " -- node" + std::to_string(children[children.size()-1]->nodenum) + "[style=invis];\n";
-            result += " { rank = same; node" + std::to_string(children[children.size()-1]->nodenum) + " ; node" + std::to_string((children[children.size()-2]->children)[((children[children.size()-2])->children.size())-1]->nodenum) + ";}\n";
-        }
-        return result;
-    }
-
-     std::string toGraphViz()  {
-        int counter = 0;
-        std::string result = "graph SyntaxTree {\n";
-        result += "  graph [rankdir=TB];\n";
-        result += "  node [fontname=\"Arial\"];\n";
-        result += "  edge [fontname=\"Arial\"];\n\n";
-
-        //bfs for level view in image
-
-
-        result += toDot(counter);
-        result += "}\n";
-
-        return result;
-    }
+#include <cstring>
+
+// Binary operators by TokenType, for the expression parser. Precedence 0
+// means the token is not a binary operator. A non-associative operator
+// cannot follow another one of the same precedence without parentheses.
+// A new operator only needs its token type and an entry here.
+struct BinaryOperator {
+    uint8_t precedence;
+    bool nonAssociative;
+    NodeKind kind;
+    const char* text;   // node value
 };
 
-// Parser Exception
-class ParserException : public std::runtime_error {
-public:
-    ParserException(const std::string& msg) : std::runtime_error(msg) {}
+static const BinaryOperator kBinaryOperators[] = {
+    {0, false, NodeKind::PROGRAM, ""},                  // SEMICOLON
+    {0, false, NodeKind::PROGRAM, ""},                  // IF
+    {0, false, NodeKind::PROGRAM, ""},                  // THEN
+    {0, false, NodeKind::PROGRAM, ""},                  // ELSE
+    {0, false, NodeKind::PROGRAM, ""},                  // END
+    {0, false, NodeKind::PROGRAM, ""},                  // REPEAT
+    {0, false, NodeKind::PROGRAM, ""},                  // UNTIL
+    {0, false, NodeKind::PROGRAM, ""},                  // IDENTIFIER
+    {0, false, NodeKind::PROGRAM, ""},                  // ASSIGN
+    {0, false, NodeKind::PROGRAM, ""},                  // READ
+    {0, false, NodeKind::PROGRAM, ""},                  // WRITE
+    {1, true,  NodeKind::COMPARISON_OP, "<"},           // LESSTHAN
+    {1, true,  NodeKind::COMPARISON_OP, "="},           // EQUAL
+    {2, false, NodeKind::ADDITIVE_OP, "+"},             // PLUS
+    {2, false, NodeKind::ADDITIVE_OP, "-"},             // MINUS
+    {3, false, NodeKind::MULTIPLICATIVE_OP, "*"},       // MUL
+    {3, false, NodeKind::MULTIPLICATIVE_OP, "/"},       // DIV
+    {0, false, NodeKind::PROGRAM, ""},                  // OPENBRACKET
+    {0, false, NodeKind::PROGRAM, ""},                  // CLOSEDBRACKET
+    {0, false, NodeKind::PROGRAM, ""},                  // NUMBER
+    {0, false, NodeKind::PROGRAM, ""},                  // UNKNOWN
+    {0, false, NodeKind::PROGRAM, ""},                  // END_OF_FILE
 };
+static_assert(sizeof(kBinaryOperators) / sizeof(kBinaryOperators[0]) == (size_t)TokenType::END_OF_FILE + 1,
+              "kBinaryOperators needs one entry per TokenType");
 
 // TINY Parser Class
+//
+// Errors are recorded in 'errors' rather than thrown. After an error the
+// parser is "panicking": match() and the rules do nothing until control is
+// back in a statement sequence. By default the parse then stops, so only
+// the first error is reported. With error recovery on, the statement
+// sequence skips to the next ';', END, UNTIL or ELSE and parsing goes on,
+// so one pass reports every error.
 class TinyParser {
 private:
-    std::vector<Token> tokens;
-    size_t currentIndex;
-    Token* currentToken;
+    std::vector<Token> tokens;   // token vector handed over to parse()
+    TokenBuffer textTokens;      // tokens read by parseFromFile
+    TokenSource* source;         // where tokens are pulled from while parsing
+    Token lookahead;             // the one token of lookahead the grammar needs
+    Token* currentToken;         // &lookahead, or nullptr at end of input
     std::vector<std::string> errors;
+    SyntaxTree tree;             // tree being built
+    std::vector<NodeId> pending; // children of the nodes still being parsed
+    bool recoverErrors;          // keep parsing after an error
+    bool panicking;              // an error was found and not yet recovered from
+
+    // Returned by a rule that failed; the tree is discarded in that case
+    static const NodeId NO_NODE = UINT32_MAX;
 
     // Get next token
     void advance() {
-        currentIndex++;
-        if (currentIndex < tokens.size()) {
-            currentToken = &tokens[currentIndex];
+        lookahead = source->nextToken();
+        if (lookahead.type != TokenType::END_OF_FILE) {
+            currentToken = &lookahead;
         } else {
             currentToken = nullptr;
         }
     }
 
+    // Record a syntax error and start panicking
+    void fail(const std::string& msg) {
+        errors.push_back("Parse error: " + msg);
+        panicking = true;
+    }
+
     // Match expected token type
-    void match(TokenType expected) {
+    bool match(TokenType expected) {
+        if (panicking) return false;
         if (currentToken == nullptr) {
-            throw ParserException("Unexpected end of input");
+            fail("Unexpected end of input");
+            return false;
         }
         if (currentToken->type != expected) {
-            throw ParserException("Expected different token type at '" + currentToken->value + "'");
+            fail("Expected different token type at '" + currentToken->text() + "'");
+            return false;
         }
         advance();
+        return true;
     }
 
-    // Grammar rules implementation
+    // Skip to a token a statement sequence can continue or end at. Stays
+    // panicking at end of input, where any further error would be a
+    // repeat of the one just reported.
+    void recover() {
+        if (!panicking || !recoverErrors) return;
+        while (currentToken != nullptr &&
+               currentToken->type != TokenType::SEMICOLON &&
+               currentToken->type != TokenType::END &&
+               currentToken->type != TokenType::UNTIL &&
+               currentToken->type != TokenType::ELSE) {
+            advance();
+        }
+        if (currentToken != nullptr) panicking = false;
+    }
 
-    // program -> stmt-sequence
-    std::shared_ptr<ASTNode> parseProgram() {
-        auto root = std::make_shared<ASTNode>("Program");
-        auto stmtSeq = parseStmtSequence();
-        root->addChild(stmtSeq);
-        return root;
+    // Drop everything left from the last parse. Buffers keep their capacity.
+    void clearParseState() {
+        errors.clear();
+        tree.clear();
+        pending.clear();
+        stack.clear();
+        operands.clear();
+        operators.clear();
+        panicking = false;
+        source = nullptr;
+        currentToken = nullptr;
     }
 
-    // stmt-sequence -> statement { ; statement }
-    std::shared_ptr<ASTNode> parseStmtSequence() {
-        auto node = std::make_shared<ASTNode>("Statement-Sequence");
+    // Node with the children pushed on 'pending' since position 'base'
+    NodeId finishNode(NodeKind kind, SourceView value, size_t base) {
+        NodeId id = tree.addNode(kind, value, pending.data() + base, (uint32_t)(pending.size() - base));
+        pending.resize(base);
+        return id;
+    }
 
-        node->addChild(parseStatement());
+    // Binary operator node over two subtrees
+    NodeId binaryNode(NodeKind kind, SourceView op, NodeId left, NodeId right) {
+        NodeId kids[2] = { left, right };
+        return tree.addNode(kind, op, kids, 2);
+    }
 
-        while (currentToken != nullptr && currentToken->type == TokenType::SEMICOLON) {
-            advance(); // consume semicolon
-            if (currentToken != nullptr &&
-                currentToken->type != TokenType::END &&
-                currentToken->type != TokenType::UNTIL &&
-                currentToken->type != TokenType::ELSE) {
-                node->addChild(parseStatement());
-            }
+    // Identifier leaf for the current token, which must be an identifier
+    NodeId matchIdentifier() {
+        NodeId id = NO_NODE;
+        if (!panicking && currentToken != nullptr && currentToken->type == TokenType::IDENTIFIER) {
+            id = tree.addNode(NodeKind::IDENTIFIER, currentToken->value, nullptr, 0);
         }
+        match(TokenType::IDENTIFIER);
+        return id;
+    }
+
+    // Grammar rules implementation
+    //
+    // Statement rules run on an explicit stack of frames rather than the
+    // native call stack, so nesting depth is limited only by memory. A
+    // frame's 'step' says where the rule resumes once the rule it called
+    // has left its node id in 'ret'. Statements without a nested statement
+    // sequence finish at once without a frame, and expressions are parsed
+    // by their own loop (parseExp).
+
+    enum class Rule : uint8_t {
+        STMT_SEQUENCE,  // statement { ; statement }
+        IF_STMT,        // IF exp THEN stmt-sequence [ ELSE stmt-sequence ] END
+        REPEAT_STMT     // REPEAT stmt-sequence UNTIL exp
+    };
+
+    struct Frame {
+        Rule rule;
+        uint8_t step;
+        size_t base;       // 'pending' size when the rule started
+    };
+
+    std::vector<Frame> stack;   // rules in progress, innermost last
+    NodeId ret;                 // node id returned by the last finished rule
+
+    // Expression parser state: operands and operators not yet reduced.
+    // An operator entry with precedence 0 marks an open parenthesis, or
+    // (at the bottom of the stack) the start of the expression.
+    struct PendingOp {
+        uint8_t precedence;
+        NodeKind kind;
+        const char* text;
+    };
+    std::vector<NodeId> operands;
+    std::vector<PendingOp> operators;
+
+    void call(Rule rule) {
+        Frame f;
+        f.rule = rule;
+        f.step = 0;
+        f.base = pending.size();
+        stack.push_back(f);
+    }
 
-        return node;
+    // Finish the innermost rule with node 'id'
+    void finish(NodeId id) {
+        ret = id;
+        stack.pop_back();
     }
 
     // statement -> if-stmt | repeat-stmt | assign-stmt | read-stmt | write-stmt
-    std::shared_ptr<ASTNode> parseStatement() {
+    void callStatement() {
+        if (panicking) { ret = NO_NODE; return; }
         if (currentToken == nullptr) {
-            throw ParserException("Unexpected end of input in statement");
+            fail("Unexpected end of input in statement");
+            ret = NO_NODE;
+            return;
         }
 
         switch (currentToken->type) {
             case TokenType::IF:
-                return parseIfStmt();
+                call(Rule::IF_STMT);
+                break;
             case TokenType::REPEAT:
-                return parseRepeatStmt();
+                call(Rule::REPEAT_STMT);
+                break;
             case TokenType::READ:
-                return parseReadStmt();
+                ret = parseReadStmt();
+                break;
             case TokenType::WRITE:
-                return parseWriteStmt();
+                ret = parseWriteStmt();
+                break;
             case TokenType::IDENTIFIER:
-                return parseAssignStmt();
+                ret = parseAssignStmt();
+                break;
             default:
-                throw ParserException("Invalid statement starting with '" + currentToken->value + "'");
-        }
-    }
-
-    // if-stmt -> IF exp THEN stmt-sequence [ ELSE stmt-sequence ] END
-    std::shared_ptr<ASTNode> parseIfStmt() {
-        auto node = std::make_shared<ASTNode>("If-Statement");
-
-        match(TokenType::IF);
-        node->addChild(parseExp());
-        match(TokenType::THEN);
-        node->addChild(parseStmtSequence());
-
-        // Handle optional ELSE clause
-        if (currentToken != nullptr && currentToken->type == TokenType::ELSE) {
-            advance(); // consume ELSE
-            node->addChild(parseStmtSequence());
+                fail("Invalid statement starting with '" + currentToken->text() + "'");
+                ret = NO_NODE;
+                break;
         }
-
-        match(TokenType::END);
-
-        return node;
-    }
-
-    // repeat-stmt -> REPEAT stmt-sequence UNTIL exp
-    std::shared_ptr<ASTNode> parseRepeatStmt() {
-        auto node = std::make_shared<ASTNode>("Repeat-Statement");
-
-        match(TokenType::REPEAT);
-        node->addChild(parseStmtSequence());
-        match(TokenType::UNTIL);
-        node->addChild(parseExp());
-
-        return node;
     }
 
     // assign-stmt -> identifier := exp
-    std::shared_ptr<ASTNode> parseAssignStmt() {
-        auto node = std::make_shared<ASTNode>("Assign-Statement");
-
-        auto idNode = std::make_shared<ASTNode>("Identifier", currentToken->value);
-        node->addChild(idNode);
-
-        match(TokenType::IDENTIFIER);
+    NodeId parseAssignStmt() {
+        NodeId kids[2];
+        kids[0] = matchIdentifier();
         match(TokenType::ASSIGN);
-        node->addChild(parseExp());
+        kids[1] = parseExp();
 
-        return node;
+        return tree.addNode(NodeKind::ASSIGN_STATEMENT, SourceView(), kids, 2);
     }
 
     // read-stmt -> READ identifier
-    std::shared_ptr<ASTNode> parseReadStmt() {
-        auto node = std::make_shared<ASTNode>("Read-Statement");
-
+    NodeId parseReadStmt() {
         match(TokenType::READ);
+        NodeId idNode = matchIdentifier();
 
-        auto idNode = std::make_shared<ASTNode>("Identifier", currentToken->value);
-        node->addChild(idNode);
-
-        match(TokenType::IDENTIFIER);
-
-        return node;
+        return tree.addNode(NodeKind::READ_STATEMENT, SourceView(), &idNode, 1);
     }
 
     // write-stmt -> WRITE exp
-    std::shared_ptr<ASTNode> parseWriteStmt() {
-        auto node = std::make_shared<ASTNode>("Write-Statement");
-
+    NodeId parseWriteStmt() {
         match(TokenType::WRITE);
-        node->addChild(parseExp());
+        NodeId exp = parseExp();
 
-        return node;
+        return tree.addNode(NodeKind::WRITE_STATEMENT, SourceView(), &exp, 1);
     }
 
-    // exp -> simple-exp [ comparison-op simple-exp ]
-    std::shared_ptr<ASTNode> parseExp() {
-        auto left = parseSimpleExp();
-
-        if (currentToken != nullptr &&
-            (currentToken->type == TokenType::LESSTHAN ||
-             currentToken->type == TokenType::EQUAL)) {
-
-            std::string op = (currentToken->type == TokenType::LESSTHAN) ? "<" : "=";
-            auto node = std::make_shared<ASTNode>("Comparison-Op", op);
-            advance();
-
-            node->addChild(left);
-            node->addChild(parseSimpleExp());
-
-            return node;
-        }
-
-        return left;
+    // Replace the top two operands with the top operator applied to them
+    void reduce() {
+        const PendingOp& top = operators.back();
+        NodeId kids[2] = { operands[operands.size() - 2], operands.back() };
+        operands.pop_back();
+        operands.back() = tree.addNode(top.kind, SourceView(top.text, std::strlen(top.text)), kids, 2);
+        operators.pop_back();
     }
 
+    // exp -> simple-exp [ comparison-op simple-exp ]
     // simple-exp -> term { addop term }
-    std::shared_ptr<ASTNode> parseSimpleExp() {
-        auto left = parseTerm();
-
-        while (currentToken != nullptr &&
-               (currentToken->type == TokenType::PLUS ||
-                currentToken->type == TokenType::MINUS)) {
-
-            std::string op = (currentToken->type == TokenType::PLUS) ? "+" : "-";
-            auto node = std::make_shared<ASTNode>("Additive-Op", op);
-            advance();
-
-            node->addChild(left);
-            node->addChild(parseTerm());
-
-            left = node;
-        }
-
-        return left;
-    }
-
     // term -> factor { mulop factor }
-    std::shared_ptr<ASTNode> parseTerm() {
-        auto left = parseFactor();
-
-        while (currentToken != nullptr &&
-               (currentToken->type == TokenType::MUL ||
-                currentToken->type == TokenType::DIV)) {
-
-            std::string op = (currentToken->type == TokenType::MUL) ? "*" : "/";
-            auto node = std::make_shared<ASTNode>("Multiplicative-Op", op);
+    // factor -> ( exp ) | number | identifier
+    //
+    // Precedence climbing over kBinaryOperators in a single loop: builds the
+    // same tree as the three grammar levels above, and stops at the same
+    // token with the same error.
+    NodeId parseExp() {
+        if (panicking) return NO_NODE;
+        const PendingOp open = { 0, NodeKind::PROGRAM, "" };
+        operands.clear();
+        operators.clear();
+        operators.push_back(open);
+
+        while (true) {
+            // Operand expected: factor
+            if (currentToken == nullptr) {
+                fail("Unexpected end of input in factor");
+                return NO_NODE;
+            }
+            TokenType type = currentToken->type;
+            if (type == TokenType::OPENBRACKET) {
+                operators.push_back(open);
+                advance();
+                continue;
+            }
+            if (type == TokenType::NUMBER) {
+                operands.push_back(tree.addNode(NodeKind::NUMBER, currentToken->value, nullptr, 0));
+            } else if (type == TokenType::IDENTIFIER) {
+                operands.push_back(tree.addNode(NodeKind::IDENTIFIER, currentToken->value, nullptr, 0));
+            } else {
+                fail("Invalid factor: '" + currentToken->text() + "'");
+                return NO_NODE;
+            }
             advance();
 
-            node->addChild(left);
-            node->addChild(parseFactor());
-
-            left = node;
-        }
+            // Operator expected: take a binary operator, or close the
+            // innermost parenthesis, or end the expression
+            while (true) {
+                const BinaryOperator& op = kBinaryOperators[currentToken != nullptr
+                    ? (int)currentToken->type : (int)TokenType::END_OF_FILE];
+                if (op.precedence > 0) {
+                    while (operators.back().precedence > op.precedence) reduce();
+                    if (operators.back().precedence < op.precedence || !op.nonAssociative) {
+                        if (operators.back().precedence == op.precedence) reduce();
+                        PendingOp next = { op.precedence, op.kind, op.text };
+                        operators.push_back(next);
+                        advance();
+                        break;
+                    }
+                    // A second non-associative operator at this level ends it
+                }
 
-        return left;
-    }
+                while (operators.back().precedence > 0) reduce();
+                if (operators.size() == 1) return operands.back();
 
-    // factor -> ( exp ) | number | identifier
-    std::shared_ptr<ASTNode> parseFactor() {
-        if (currentToken == nullptr) {
-            throw ParserException("Unexpected end of input in factor");
+                if (!match(TokenType::CLOSEDBRACKET)) return NO_NODE;
+                operators.pop_back();
+            }
         }
+    }
 
-        if (currentToken->type == TokenType::OPENBRACKET) {
-            advance();
-            auto exp = parseExp();
-            match(TokenType::CLOSEDBRACKET);
-            return exp;
-        }
-        else if (currentToken->type == TokenType::NUMBER) {
-            auto node = std::make_shared<ASTNode>("Number", currentToken->value);
-            advance();
-            return node;
-        }
-        else if (currentToken->type == TokenType::IDENTIFIER) {
-            auto node = std::make_shared<ASTNode>("Identifier", currentToken->value);
-            advance();
-            return node;
-        }
-        else {
-            throw ParserException("Invalid factor: '" + currentToken->value + "'");
+    // Run 'rule' and every rule it calls to completion
+    NodeId run(Rule rule) {
+        stack.clear();
+        call(rule);
+
+        while (!stack.empty()) {
+            // Set 'step' before call() or callStatement(): they may grow
+            // the stack, after which 'f' is no longer valid
+            Frame& f = stack.back();
+
+            switch (f.rule) {
+            case Rule::STMT_SEQUENCE:
+                if (f.step == 0) {
+                    f.step = 1;
+                    callStatement();
+                    break;
+                }
+                pending.push_back(ret);
+                recover();
+                {
+                    bool calledNext = false;
+                    while (!calledNext && !panicking && currentToken != nullptr &&
+                           currentToken->type == TokenType::SEMICOLON) {
+                        advance(); // consume semicolon
+                        if (currentToken != nullptr &&
+                            currentToken->type != TokenType::END &&
+                            currentToken->type != TokenType::UNTIL &&
+                            currentToken->type != TokenType::ELSE) {
+                            callStatement(); // resumes at step 1
+                            calledNext = true;
+                        }
+                    }
+                    if (!calledNext) {
+                        finish(finishNode(NodeKind::STATEMENT_SEQUENCE, SourceView(), f.base));
+                    }
+                }
+                break;
+
+            case Rule::IF_STMT:
+                switch (f.step) {
+                case 0:
+                    match(TokenType::IF);
+                    pending.push_back(parseExp());
+                    match(TokenType::THEN);
+                    f.step = 1;
+                    call(Rule::STMT_SEQUENCE);
+                    break;
+                case 1:
+                    pending.push_back(ret);
+                    // Handle optional ELSE clause
+                    if (!panicking && currentToken != nullptr && currentToken->type == TokenType::ELSE) {
+                        advance(); // consume ELSE
+                        f.step = 2;
+                        call(Rule::STMT_SEQUENCE);
+                        break;
+                    }
+                    match(TokenType::END);
+                    finish(finishNode(NodeKind::IF_STATEMENT, SourceView(), f.base));
+                    break;
+                default:
+                    pending.push_back(ret);
+                    match(TokenType::END);
+                    finish(finishNode(NodeKind::IF_STATEMENT, SourceView(), f.base));
+                    break;
+                }
+                break;
+
+            case Rule::REPEAT_STMT:
+                if (f.step == 0) {
+                    match(TokenType::REPEAT);
+                    f.step = 1;
+                    call(Rule::STMT_SEQUENCE);
+                    break;
+                }
+                pending.push_back(ret);
+                match(TokenType::UNTIL);
+                pending.push_back(parseExp());
+                finish(finishNode(NodeKind::REPEAT_STATEMENT, SourceView(), f.base));
+                break;
+            }
         }
+        return ret;
     }
 
+    // program -> stmt-sequence
+    NodeId parseProgram() {
+        NodeId stmtSeq = parseStmtSequence();
+        return tree.addNode(NodeKind::PROGRAM, SourceView(), &stmtSeq, 1);
+    }
 
-
-
+    NodeId parseStmtSequence() {
+        return run(Rule::STMT_SEQUENCE);
+    }
 
 public:
-    TinyParser() : currentIndex(0), currentToken(nullptr) {}
+    TinyParser() : source(nullptr), currentToken(nullptr), recoverErrors(false), panicking(false), ret(NO_NODE) {}
+
+    // Report every syntax error in one pass instead of stopping at the first
+    void setErrorRecovery(bool on) { recoverErrors = on; }
+
+    // Forget the last input, tokens and errors. Internal buffers keep their
+    // capacity, so one parser can be reused for many files without
+    // reallocating.
+    void reset() {
+        tokens.clear();
+        textTokens.reset("", 0);
+        clearParseState();
+    }
 
     // Parse result structure
     struct ParseResult {
-        std::shared_ptr<ASTNode> ast;
+        SyntaxTree ast;
         std::vector<std::string> errors;
-        bool success;
+        bool success = false;
     };
 
-    // Parse from scanner output file format: "value , TYPE"
+    // Parse from scanner output file format: "value , TYPE", or from a
+    // binary token file (tiny_scanner --binary), whose tokens are used in
+    // place. Token values view into 'content' either way.
     ParseResult parseFromFile(const std::string& content) {
         ParseResult result;
         result.success = false;
@@ -415,153 +465,151 @@ public:
             tokens.clear();
             errors.clear();
 
-            std::istringstream iss(content);
-            std::string line;
-
-            while (std::getline(iss, line)) {
-                if (line.empty()) continue;
-
-                // Parse format: "value , TYPE"
-                size_t commaPos = line.find(" , ");
-                if (commaPos == std::string::npos) {
-                    commaPos = line.find(",");
-                    if (commaPos == std::string::npos) continue;
-                }
-
-                std::string value = line.substr(0, commaPos);
-                std::string typeStr = line.substr(commaPos + (line[commaPos + 1] == ',' ? 2 : 3));
-
-                // Trim whitespace
-                value.erase(0, value.find_first_not_of(" \t\r\n"));
-                value.erase(value.find_last_not_of(" \t\r\n") + 1);
-                typeStr.erase(0, typeStr.find_first_not_of(" \t\r\n"));
-                typeStr.erase(typeStr.find_last_not_of(" \t\r\n") + 1);
-
-                TokenType type = stringToTokenType(typeStr);
-                if (type == TokenType::UNKNOWN && typeStr != "UNKNOWN") {
-                    errors.push_back("Unknown token type: " + typeStr);
-                    result.errors = errors;
-                    return result;
-                }
-
-                tokens.emplace_back(value, type);
-            }
-
-            if (tokens.empty()) {
-                errors.push_back("Error: Empty token list");
-                result.errors = errors;
+            if (isTokenFile(content.data(), content.size())) {
+                TokenFile file(content.data(), content.size());
+                TokenFileSource fileSource(file);
+                parse(fileSource, result);
                 return result;
             }
 
-            currentIndex = 0;
-            currentToken = &tokens[0];
-
-            // Parse the program
-            result.ast = parseProgram();
-
-            // Check if all tokens were consumed
-            if (currentToken != nullptr && currentToken->type != TokenType::END_OF_FILE) {
-                errors.push_back("Unexpected tokens after end of program");
+            TokenTextReader reader(content.data(), content.size());
+            if (!reader.read(textTokens)) {
+                errors.push_back("Unknown token type: " + reader.unknownType().str());
+                result.errors.swap(errors);
+                return result;
             }
 
-            result.success = errors.empty();
-            result.errors = errors;
-
-        } catch (const ParserException& e) {
-            errors.push_back(std::string("Parse error: ") + e.what());
-            result.errors = errors;
-            result.success = false;
         } catch (const std::exception& e) {
             errors.push_back(std::string("Unexpected error: ") + e.what());
-            result.errors = errors;
-            result.success = false;
+            result.errors.swap(errors);
+            return result;
         }
 
+        TokenBufferSource bufferSource(textTokens);
+        parse(bufferSource, result);
         return result;
     }
 
     // Parse from vector of tokens (for direct integration)
     ParseResult parse(const std::vector<Token>& tokenList) {
+        return parse(tokenList.data(), tokenList.size());
+    }
+
+    // Parse from a token vector the parser may keep; it holds the tokens
+    // until the next parse or reset()
+    ParseResult parse(std::vector<Token>&& tokenList) {
+        tokens = std::move(tokenList);
+        return parse(tokens.data(), tokens.size());
+    }
+
+    // Parse from 'count' tokens at 'tokenData', without copying them
+    ParseResult parse(const Token* tokenData, size_t count) {
         ParseResult result;
-        result.success = false;
+        parse(tokenData, count, result);
+        return result;
+    }
 
-        try {
-            tokens = tokenList;
-            errors.clear();
+    void parse(const Token* tokenData, size_t count, ParseResult& result) {
+        TokenListSource list(tokenData, count);
+        parse(list, result);
+    }
 
-            if (tokens.empty()) {
-                errors.push_back("Error: Empty token list");
-                result.errors = errors;
-                return result;
-            }
+    // Parse from a structure-of-arrays token buffer
+    ParseResult parse(const TokenBuffer& buffer) {
+        TokenBufferSource bufferSource(buffer);
+        return parse(bufferSource);
+    }
 
-            currentIndex = 0;
-            currentToken = &tokens[0];
+    // Parse tokens pulled on demand from a scanner or other source, so
+    // scanning and parsing run interleaved without a full token vector
+    ParseResult parse(TokenSource& tokenSource) {
+        ParseResult result;
+        parse(tokenSource, result);
+        return result;
+    }
 
-            // Parse the program
-            result.ast = parseProgram();
+    // Parse into 'result', reusing the tree and error list memory it holds
+    // from an earlier parse. Together with a reused parser this makes a
+    // batch of parses allocation-free once the buffers have grown.
+    void parse(TokenSource& tokenSource, ParseResult& result) {
+        result.success = false;
+        result.errors.clear();
+        clearParseState();
 
-            // Check if all tokens were consumed
-            if (currentToken != nullptr && currentToken->type != TokenType::END_OF_FILE) {
-                errors.push_back("Unexpected tokens after end of program");
-            }
+        // Build the tree in the memory 'result' held
+        tree.swap(result.ast);
+        tree.clear();
 
-            result.success = errors.empty();
-            result.errors = errors;
+        try {
+            source = &tokenSource;
+            advance();
+
+            if (currentToken == nullptr) {
+                errors.push_back("Error: Empty token list");
+            } else {
+                // Parse the program
+                parseProgram();
+
+                // Check if all tokens were consumed. When recovering, skip past
+                // the stray token to the next statement and parse on from there.
+                while (!panicking && currentToken != nullptr) {
+                    errors.push_back("Unexpected tokens after end of program");
+                    if (!recoverErrors) break;
+                    advance();
+                    panicking = true;
+                    recover();
+                    while (currentToken != nullptr && currentToken->type == TokenType::SEMICOLON) advance();
+                    if (currentToken != nullptr) parseStmtSequence();
+                }
+            }
 
-        } catch (const ParserException& e) {
-            errors.push_back(std::string("Parse error: ") + e.what());
-            result.errors = errors;
-            result.success = false;
         } catch (const std::exception& e) {
             errors.push_back(std::string("Unexpected error: ") + e.what());
-            result.errors = errors;
-            result.success = false;
         }
 
-        return result;
+        result.success = errors.empty();
+        if (result.success) {
+            result.ast.swap(tree);
+        } else {
+            result.ast.clear();
+        }
+        result.errors.swap(errors);
+        source = nullptr;
     }
 
     // Get syntax tree as string
-    std::string getTreeString(const std::shared_ptr<ASTNode>& root) {
-        if (root == nullptr) {
+    std::string getTreeString(const SyntaxTree& ast) {
+        if (ast.empty()) {
             return "Empty tree";
         }
-        return root->toString();
+        return ast.toString();
     }
 
     // Get syntax tree as GraphViz DOT format
-    std::string getTreeDot(const std::shared_ptr<ASTNode>& root) {
-        if (root == nullptr) {
+    std::string getTreeDot(const SyntaxTree& ast) {
+        if (ast.empty()) {
             return "digraph SyntaxTree { empty [label=\"Empty Tree\"]; }";
         }
-        return root->toGraphViz();
+        return ast.toGraphViz();
     }
 
-    // Generate PNG image of syntax tree (requires GraphViz installed)
-    bool generateTreePNG(const std::shared_ptr<ASTNode>& root, const std::string& outputPath) {
-        if (root == nullptr) {
+    // Draw the syntax tree as an SVG image (laid out in-process, see
+    // TinyLayout.h)
+    bool generateTreeSVG(const SyntaxTree& ast, const std::string& outputPath) {
+        if (ast.empty()) {
             return false;
         }
 
-        // Generate DOT file
-        std::string dotPath = outputPath + ".dot";
-        std::ofstream dotFile(dotPath);
-        if (!dotFile) {
+        std::ofstream svgFile(outputPath, std::ios::out | std::ios::binary);
+        if (!svgFile) {
             return false;
         }
 
-        dotFile << root->toGraphViz();
-        dotFile.close();
-
-        // Call GraphViz dot command to generate PNG
-        std::string command = "dot -Tpng \"" + dotPath + "\" -o \"" + outputPath + "\"";
-        int result = system(command.c_str());
-
-        // Clean up DOT file (optional - comment out to keep it)
-        // remove(dotPath.c_str());
-
-        return result == 0;
+        TreeLayout layout(ast);
+        StreamSink out(svgFile);
+        layout.writeSVG(out);
+        out.flush();
+        return out.good();
     }
 };
 
@@ -0,0 +1,127 @@
+#ifndef TINY_REFERENCE_SCANNER_H
+#define TINY_REFERENCE_SCANNER_H
+
+#include "TinyCommon.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cctype>
+
+// Straightforward character-by-character scanner.
+// Kept as the reference that the table-driven Scanner in TinyScanner.h must
+// match token for token; use Scanner everywhere else.
+// Tokens view into the scanned buffer, so the buffer must outlive them.
+class ReferenceScanner {
+    const char* input;
+    size_t pos = 0;
+    size_t len = 0;
+
+public:
+    // A leading UTF-8 BOM is skipped; CR is plain whitespace, so CRLF
+    // input needs no normalization pass
+    ReferenceScanner(const std::string &s): input(s.data()), pos(bomLength(s.data(), s.size())), len(s.size()) {}
+    ReferenceScanner(const char* data, size_t size): input(data), pos(bomLength(data, size)), len(size) {}
+    ReferenceScanner(std::string&&) = delete; // tokens would dangle
+
+    char peek() const {
+        if (pos < len) return input[pos];
+        return '\0';
+    }
+
+    char get() {
+        if (pos < len) return input[pos++];
+        return '\0';
+    }
+
+    void skipWhitespace() {
+        while (std::isspace((unsigned char)peek())) get();
+    }
+
+    void skipComment() {
+        if (peek() == '{') {
+            get();
+            while (peek() != '\0' && peek() != '}') get();
+            if (peek() == '}') get();
+        }
+    }
+
+    Token nextToken() {
+        while (true) {
+            skipWhitespace();
+            if (peek() == '{') { skipComment(); continue; }
+            break;
+        }
+
+        size_t start = pos;
+        char c = peek();
+        if (c == '\0') return {view(start), TokenType::END_OF_FILE};
+
+        if (c == ':') {
+            get();
+            if (peek() == '=') {
+                get();
+                return {view(start), TokenType::ASSIGN};
+            } else {
+                return {view(start), TokenType::UNKNOWN};
+            }
+        }
+
+        if (c == ';') { get(); return {view(start), TokenType::SEMICOLON}; }
+        if (c == '<') { get(); return {view(start), TokenType::LESSTHAN}; }
+        if (c == '=') { get(); return {view(start), TokenType::EQUAL}; }
+        if (c == '+') { get(); return {view(start), TokenType::PLUS}; }
+        if (c == '-') { get(); return {view(start), TokenType::MINUS}; }
+        if (c == '*') { get(); return {view(start), TokenType::MUL}; }
+        if (c == '/') { get(); return {view(start), TokenType::DIV}; }
+        if (c == '(') { get(); return {view(start), TokenType::OPENBRACKET}; }
+        if (c == ')') { get(); return {view(start), TokenType::CLOSEDBRACKET}; }
+
+        if (std::isdigit((unsigned char)c)) {
+            while (std::isdigit((unsigned char)peek())) get();
+            return {view(start), TokenType::NUMBER};
+        }
+
+        if (std::isalpha((unsigned char)c)) {
+            while (std::isalpha((unsigned char)peek())) get();
+            std::string lw(input + start, pos - start);
+            std::transform(lw.begin(), lw.end(), lw.begin(), [](unsigned char ch){ return std::tolower(ch); });
+            auto it = keywords().find(lw);
+            if (it != keywords().end()) return {view(start), it->second};
+            else return {view(start), TokenType::IDENTIFIER};
+        }
+
+        get();
+        return {view(start), TokenType::UNKNOWN};
+    }
+
+    // Scan all tokens and return as a vector
+    std::vector<Token> scanAll() {
+        std::vector<Token> tokens;
+        while (true) {
+            Token tok = nextToken();
+            if (tok.type == TokenType::END_OF_FILE) break;
+            tokens.push_back(tok);
+        }
+        return tokens;
+    }
+
+private:
+    // Its own keyword table rather than lookupKeyword(), so that Scanner's
+    // keyword switch is checked against an independent implementation
+    static const std::unordered_map<std::string, TokenType>& keywords() {
+        static const std::unordered_map<std::string, TokenType> table = {
+            {"if", TokenType::IF}, {"then", TokenType::THEN}, {"else", TokenType::ELSE},
+            {"end", TokenType::END}, {"repeat", TokenType::REPEAT}, {"until", TokenType::UNTIL},
+            {"read", TokenType::READ}, {"write", TokenType::WRITE}
+        };
+        return table;
+    }
+
+    // Source text from 'start' up to the current position
+    SourceView view(size_t start) const {
+        return SourceView(input + start, pos - start);
+    }
+};
+
+#endif // TINY_REFERENCE_SCANNER_H
@@ -2,95 +2,146 @@
 #define TINY_SCANNER_H
 
 #include "TinyCommon.h"
+#include "TinySimd.h"
+#include "TinyTokenBuffer.h"
 #include <string>
 #include <vector>
-#include <algorithm>
-#include <cctype>
+#include <cstdint>
+
+// Character classes used by the scanner DFA.
+// A NUL byte ends the input, the same as running off the end of the buffer.
+enum CharClass : uint8_t {
+    CC_OTHER, CC_SPACE, CC_DIGIT, CC_LETTER, CC_COLON, CC_EQUAL, CC_SEMI,
+    CC_LESS, CC_PLUS, CC_MINUS, CC_STAR, CC_SLASH, CC_LPAREN, CC_RPAREN,
+    CC_LBRACE, CC_RBRACE, CC_EOF,
+    CC_COUNT
+};
+
+// Byte -> character class. Plain ASCII only, so the result never depends
+// on the current C locale the way std::isspace/std::isalpha do.
+#define TINY_CC_ROW_OTHER CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, \
+                          CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER
+static const uint8_t kCharClass[256] = {
+    // 0x00 - 0x0F: NUL ends input, \t \n \v \f \r are spaces
+    CC_EOF,   CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER,
+    CC_OTHER, CC_SPACE, CC_SPACE, CC_SPACE, CC_SPACE, CC_SPACE, CC_OTHER, CC_OTHER,
+    // 0x10 - 0x1F
+    TINY_CC_ROW_OTHER,
+    // 0x20 - 0x2F:  ! " # $ % & ' ( ) * + , - . /
+    CC_SPACE, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER, CC_OTHER,
+    CC_LPAREN, CC_RPAREN, CC_STAR, CC_PLUS, CC_OTHER, CC_MINUS, CC_OTHER, CC_SLASH,
+    // 0x30 - 0x3F: 0-9 : ; < = > ?
+    CC_DIGIT, CC_DIGIT, CC_DIGIT, CC_DIGIT, CC_DIGIT, CC_DIGIT, CC_DIGIT, CC_DIGIT,
+    CC_DIGIT, CC_DIGIT, CC_COLON, CC_SEMI, CC_LESS, CC_EQUAL, CC_OTHER, CC_OTHER,
+    // 0x40 - 0x5F: @ A-Z [ \ ] ^ _
+    CC_OTHER,  CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+    CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+    CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+    CC_LETTER, CC_LETTER, CC_LETTER, CC_OTHER,  CC_OTHER,  CC_OTHER,  CC_OTHER,  CC_OTHER,
+    // 0x60 - 0x7F: ` a-z { | } ~ DEL
+    CC_OTHER,  CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+    CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+    CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER, CC_LETTER,
+    CC_LETTER, CC_LETTER, CC_LETTER, CC_LBRACE, CC_OTHER,  CC_RBRACE, CC_OTHER,  CC_OTHER,
+    // 0x80 - 0xFF
+    TINY_CC_ROW_OTHER, TINY_CC_ROW_OTHER, TINY_CC_ROW_OTHER, TINY_CC_ROW_OTHER,
+    TINY_CC_ROW_OTHER, TINY_CC_ROW_OTHER, TINY_CC_ROW_OTHER, TINY_CC_ROW_OTHER
+};
+#undef TINY_CC_ROW_OTHER
+
+// Scanner DFA states. Entries of kTransition below 0x80 are the next state;
+// entries with DFA_ACCEPT set end the token with the TokenType in the low
+// bits, and DFA_CONSUME says whether the current byte belongs to it.
+enum ScanState : uint8_t {
+    ST_START, ST_COMMENT, ST_NUMBER, ST_WORD, ST_COLON,
+    ST_COUNT
+};
 
-class Scanner {
-    std::string input;
+enum : uint8_t {
+    DFA_ACCEPT  = 0x80,
+    DFA_CONSUME = 0x40,
+    DFA_TYPE    = 0x3F
+};
+
+#define A(t)  uint8_t(DFA_ACCEPT | uint8_t(TokenType::t))
+#define AC(t) uint8_t(DFA_ACCEPT | DFA_CONSUME | uint8_t(TokenType::t))
+static const uint8_t kTransition[ST_COUNT][CC_COUNT] = {
+    //  OTHER        SPACE       DIGIT      LETTER      COLON     EQUAL      SEMI           LESS          PLUS      MINUS      STAR     SLASH    LPAREN            RPAREN              LBRACE      RBRACE       EOF
+    { AC(UNKNOWN), ST_START,   ST_NUMBER, ST_WORD,    ST_COLON, AC(EQUAL), AC(SEMICOLON), AC(LESSTHAN), AC(PLUS), AC(MINUS), AC(MUL), AC(DIV), AC(OPENBRACKET), AC(CLOSEDBRACKET), ST_COMMENT, AC(UNKNOWN), A(END_OF_FILE) }, // START
+    { ST_COMMENT,  ST_COMMENT, ST_COMMENT, ST_COMMENT, ST_COMMENT, ST_COMMENT, ST_COMMENT,  ST_COMMENT,   ST_COMMENT, ST_COMMENT, ST_COMMENT, ST_COMMENT, ST_COMMENT,    ST_COMMENT,        ST_COMMENT, ST_START,    A(END_OF_FILE) }, // COMMENT
+    { A(NUMBER),   A(NUMBER),  ST_NUMBER, A(NUMBER),  A(NUMBER), A(NUMBER), A(NUMBER),    A(NUMBER),    A(NUMBER), A(NUMBER), A(NUMBER), A(NUMBER), A(NUMBER),     A(NUMBER),         A(NUMBER),  A(NUMBER),   A(NUMBER) },      // NUMBER
+    { A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), ST_WORD, A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER), A(IDENTIFIER) }, // WORD
+    { A(UNKNOWN),  A(UNKNOWN), A(UNKNOWN), A(UNKNOWN), A(UNKNOWN), AC(ASSIGN), A(UNKNOWN),  A(UNKNOWN),   A(UNKNOWN), A(UNKNOWN), A(UNKNOWN), A(UNKNOWN), A(UNKNOWN),    A(UNKNOWN),        A(UNKNOWN), A(UNKNOWN),  A(UNKNOWN) }     // COLON
+};
+#undef A
+#undef AC
+
+// Table-driven scanner: one character-class lookup and one transition
+// lookup per input byte, except that whitespace runs and {} comments are
+// skipped 16/32 bytes at a time by the kernels in TinySimd.h.
+// Produces exactly the same tokens as ReferenceScanner (TinyReferenceScanner.h).
+// Tokens view into the scanned buffer instead of owning a copy, so the
+// buffer must outlive them.
+class Scanner : public TokenSource {
+    const char* input;
     size_t pos = 0;
     size_t len = 0;
+    const SkipKernels* skip = &skipKernels();
 
 public:
-    Scanner(const std::string &s): input(s), pos(0), len(s.size()) {}
-
-    char peek() const {
-        if (pos < len) return input[pos];
-        return '\0';
-    }
-
-    char get() {
-        if (pos < len) return input[pos++];
-        return '\0';
+    // A leading UTF-8 BOM is skipped; CR is plain whitespace, so CRLF
+    // input needs no normalization pass
+    Scanner(const std::string &s): input(s.data()), pos(bomLength(s.data(), s.size())), len(s.size()) {}
+    Scanner(const char* data, size_t size): input(data), pos(bomLength(data, size)), len(size) {}
+    // Resume scanning at 'start', e.g. the start of a token in the middle of
+    // a buffer; no BOM check is made there
+    Scanner(const char* data, size_t size, size_t start): input(data), pos(start), len(size) {}
+    Scanner(std::string&&) = delete; // tokens would dangle
+
+    // Skip whitespace and comments up to the start of the next token.
+    // An unterminated comment stops at the end of input (or a NUL byte),
+    // which the DFA then reports as END_OF_FILE.
+    void skipWhitespaceAndComments() {
+        while (pos < len) {
+            if (isTinySpace(input[pos])) {
+                pos = skip->skipSpaces(input, pos + 1, len);
+            } else if (input[pos] == '{') {
+                pos = skip->findCommentEnd(input, pos + 1, len);
+                if (pos < len && input[pos] == '}') pos++;
+            } else {
+                break;
+            }
+        }
     }
 
-    void skipWhitespace() {
-        while (std::isspace((unsigned char)peek())) get();
-    }
+    Token nextToken() override {
+        skipWhitespaceAndComments();
 
-    void skipComment() {
-        if (peek() == '{') {
-            get();
-            while (peek() != '\0' && peek() != '}') get();
-            if (peek() == '}') get();
-        }
-    }
+        uint8_t state = ST_START;
+        size_t start = pos;
+        uint8_t action;
 
-    Token nextToken() {
         while (true) {
-            skipWhitespace();
-            if (peek() == '{') { skipComment(); continue; }
-            break;
+            if (state == ST_START) start = pos;
+            uint8_t cls = pos < len ? kCharClass[(unsigned char)input[pos]] : uint8_t(CC_EOF);
+            action = kTransition[state][cls];
+            if (action & DFA_ACCEPT) break;
+            state = action;
+            pos++;
         }
 
-        char c = peek();
-        if (c == '\0') return {"", TokenType::END_OF_FILE};
+        if (action & DFA_CONSUME) pos++;
+        TokenType type = TokenType(action & DFA_TYPE);
 
-        if (c == ':') {
-            get();
-            if (peek() == '=') {
-                get();
-                return {":=", TokenType::ASSIGN};
-            } else {
-                return {":", TokenType::UNKNOWN};
-            }
+        if (type == TokenType::END_OF_FILE) {
+            return {SourceView(input + pos, 0), type};
         }
 
-        if (c == ';') { get(); return {";", TokenType::SEMICOLON}; }
-        if (c == '<') { get(); return {"<", TokenType::LESSTHAN}; }
-        if (c == '=') { get(); return {"=", TokenType::EQUAL}; }
-        if (c == '+') { get(); return {"+", TokenType::PLUS}; }
-        if (c == '-') { get(); return {"-", TokenType::MINUS}; }
-        if (c == '*') { get(); return {"*", TokenType::MUL}; }
-        if (c == '/') { get(); return {"/", TokenType::DIV}; }
-        if (c == '(') { get(); return {"(", TokenType::OPENBRACKET}; }
-        if (c == ')') { get(); return {")", TokenType::CLOSEDBRACKET}; }
-
-        if (std::isdigit((unsigned char)c)) {
-            std::string num;
-            while (std::isdigit((unsigned char)peek())) num.push_back(get());
-            return {num, TokenType::NUMBER};
+        if (type == TokenType::IDENTIFIER) {
+            type = lookupKeyword(input + start, pos - start);
         }
 
-        if (std::isalpha((unsigned char)c)) {
-            std::string word;
-            while (std::isalpha((unsigned char)peek())) word.push_back(get());
-
-            std::string lw = word;
-            std::transform(lw.begin(), lw.end(), lw.begin(), [](unsigned char ch){ return std::tolower(ch); });
-            auto it = keywords.find(lw);
-
-            if (it != keywords.end()) {
-                return {word, it->second};
-            }
-            else {
-                return {word, TokenType::IDENTIFIER};
-            }
-        }
-
-        std::string unk(1, get());
-        return {unk, TokenType::UNKNOWN};
+        return {SourceView(input + start, pos - start), type};
     }
 
     // Scan all tokens and return as a vector
@@ -103,6 +154,16 @@ public:
         }
         return tokens;
     }
+
+    // Scan all tokens into a structure-of-arrays buffer
+    void scanAll(TokenBuffer& out) {
+        out.reset(input, len);
+        while (true) {
+            Token tok = nextToken();
+            if (tok.type == TokenType::END_OF_FILE) break;
+            out.push(tok);
+        }
+    }
 };
 
 #endif // TINY_SCANNER_H
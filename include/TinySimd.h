@@ -0,0 +1,217 @@
+#ifndef TINY_SIMD_H
+#define TINY_SIMD_H
+
+// Vectorized helpers for the scanner's whitespace and comment skipping.
+// The widest kernel the CPU supports is picked at runtime (AVX2, then SSE2),
+// with a portable scalar fallback. Set TINY_SIMD=scalar or TINY_SIMD=sse2 in
+// the environment to cap the width, e.g. for benchmarking.
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TINY_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(TINY_HAVE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TINY_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit; 'bits' must be non-zero
+inline unsigned tinyCtz(unsigned bits) {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, bits);
+    return (unsigned)idx;
+#else
+    return (unsigned)__builtin_ctz(bits);
+#endif
+}
+
+// 64-bit versions: lowest and highest set bit; 'bits' must be non-zero
+inline unsigned tinyCtz64(unsigned long long bits) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanForward64(&idx, bits);
+    return (unsigned)idx;
+#elif defined(_MSC_VER)
+    return (unsigned)bits != 0 ? tinyCtz((unsigned)bits) : 32 + tinyCtz((unsigned)(bits >> 32));
+#else
+    return (unsigned)__builtin_ctzll(bits);
+#endif
+}
+
+inline unsigned tinyHighBit64(unsigned long long bits) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanReverse64(&idx, bits);
+    return (unsigned)idx;
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    if (bits >> 32) {
+        _BitScanReverse(&idx, (unsigned long)(bits >> 32));
+        return 32 + (unsigned)idx;
+    }
+    _BitScanReverse(&idx, (unsigned long)bits);
+    return (unsigned)idx;
+#else
+    return 63u - (unsigned)__builtin_clzll(bits);
+#endif
+}
+
+// Same whitespace set as std::isspace in the C locale
+inline bool isTinySpace(char c) {
+    return c == ' ' || (unsigned char)(c - '\t') <= (unsigned char)('\r' - '\t');
+}
+
+// First index >= pos that is not whitespace, or len
+inline size_t skipSpacesScalar(const char* s, size_t pos, size_t len) {
+    while (pos < len && isTinySpace(s[pos])) pos++;
+    return pos;
+}
+
+// First index >= pos holding '}' or NUL (which ends the input), or len
+inline size_t findCommentEndScalar(const char* s, size_t pos, size_t len) {
+    while (pos < len && s[pos] != '}' && s[pos] != '\0') pos++;
+    return pos;
+}
+
+// Most runs between tokens are a few bytes long, and for those a vector
+// compare costs more than it saves, so the vector kernels look at this many
+// bytes one at a time before entering their loop (see tests/simd_bench.cpp)
+#ifndef TINY_SIMD_SCALAR_PREFIX
+#define TINY_SIMD_SCALAR_PREFIX 8
+#endif
+
+// Scalar checks of the first TINY_SIMD_SCALAR_PREFIX bytes; true with 'pos'
+// final if the run ended there
+inline bool skipSpacesPrefix(const char* s, size_t& pos, size_t len) {
+    size_t end = len - pos > TINY_SIMD_SCALAR_PREFIX ? pos + TINY_SIMD_SCALAR_PREFIX : len;
+    while (pos < end && isTinySpace(s[pos])) pos++;
+    return pos < end || pos == len;
+}
+
+inline bool findCommentEndPrefix(const char* s, size_t& pos, size_t len) {
+    size_t end = len - pos > TINY_SIMD_SCALAR_PREFIX ? pos + TINY_SIMD_SCALAR_PREFIX : len;
+    while (pos < end && s[pos] != '}' && s[pos] != '\0') pos++;
+    return pos < end || pos == len;
+}
+
+#ifdef TINY_HAVE_SSE2
+// 16-byte loop and scalar tail, without the prefix check
+inline size_t skipSpacesSse2Blocks(const char* s, size_t pos, size_t len) {
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i ctrlSpan = _mm_set1_epi8('\r' - '\t');
+    while (pos + 16 <= len) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + pos));
+        // \t..\r map to 0..4 after subtracting '\t'; unsigned min finds them
+        __m128i rel = _mm_sub_epi8(v, tab);
+        __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(rel, ctrlSpan), rel);
+        __m128i space = _mm_or_si128(ctrl, _mm_cmpeq_epi8(v, blank));
+        unsigned other = ~(unsigned)_mm_movemask_epi8(space) & 0xFFFFu;
+        if (other) return pos + tinyCtz(other);
+        pos += 16;
+    }
+    return skipSpacesScalar(s, pos, len);
+}
+
+inline size_t findCommentEndSse2Blocks(const char* s, size_t pos, size_t len) {
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i zero = _mm_setzero_si128();
+    while (pos + 16 <= len) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + pos));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, close), _mm_cmpeq_epi8(v, zero));
+        unsigned bits = (unsigned)_mm_movemask_epi8(hit);
+        if (bits) return pos + tinyCtz(bits);
+        pos += 16;
+    }
+    return findCommentEndScalar(s, pos, len);
+}
+
+inline size_t skipSpacesSse2(const char* s, size_t pos, size_t len) {
+    if (skipSpacesPrefix(s, pos, len)) return pos;
+    return skipSpacesSse2Blocks(s, pos, len);
+}
+
+inline size_t findCommentEndSse2(const char* s, size_t pos, size_t len) {
+    if (findCommentEndPrefix(s, pos, len)) return pos;
+    return findCommentEndSse2Blocks(s, pos, len);
+}
+#endif
+
+#ifdef TINY_HAVE_AVX2
+__attribute__((target("avx2")))
+inline size_t skipSpacesAvx2(const char* s, size_t pos, size_t len) {
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i ctrlSpan = _mm256_set1_epi8('\r' - '\t');
+    if (skipSpacesPrefix(s, pos, len)) return pos;
+    while (pos + 32 <= len) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + pos));
+        __m256i rel = _mm256_sub_epi8(v, tab);
+        __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(rel, ctrlSpan), rel);
+        __m256i space = _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(v, blank));
+        unsigned other = ~(unsigned)_mm256_movemask_epi8(space);
+        if (other) return pos + tinyCtz(other);
+        pos += 32;
+    }
+    return skipSpacesSse2Blocks(s, pos, len);
+}
+
+__attribute__((target("avx2")))
+inline size_t findCommentEndAvx2(const char* s, size_t pos, size_t len) {
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i zero = _mm256_setzero_si256();
+    if (findCommentEndPrefix(s, pos, len)) return pos;
+    while (pos + 32 <= len) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + pos));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(v, close), _mm256_cmpeq_epi8(v, zero));
+        unsigned bits = (unsigned)_mm256_movemask_epi8(hit);
+        if (bits) return pos + tinyCtz(bits);
+        pos += 32;
+    }
+    return findCommentEndSse2Blocks(s, pos, len);
+}
+#endif
+
+// Skip kernels selected for this CPU
+struct SkipKernels {
+    size_t (*skipSpaces)(const char* s, size_t pos, size_t len);
+    size_t (*findCommentEnd)(const char* s, size_t pos, size_t len);
+    const char* name;
+};
+
+inline SkipKernels selectSkipKernels() {
+    // TINY_SIMD caps the kernel width; anything else means "best available"
+    const char* forced = std::getenv("TINY_SIMD");
+    bool allowSse2 = forced == nullptr || std::strcmp(forced, "scalar") != 0;
+    bool allowAvx2 = allowSse2 && (forced == nullptr || std::strcmp(forced, "sse2") != 0);
+    (void)allowAvx2;
+
+#ifdef TINY_HAVE_AVX2
+    if (allowAvx2 && __builtin_cpu_supports("avx2")) {
+        return {skipSpacesAvx2, findCommentEndAvx2, "avx2"};
+    }
+#endif
+#ifdef TINY_HAVE_SSE2
+    if (allowSse2) {
+        return {skipSpacesSse2, findCommentEndSse2, "sse2"};
+    }
+#endif
+    return {skipSpacesScalar, findCommentEndScalar, "scalar"};
+}
+
+inline const SkipKernels& skipKernels() {
+    static const SkipKernels kernels = selectSkipKernels();
+    return kernels;
+}
+
+#endif // TINY_SIMD_H
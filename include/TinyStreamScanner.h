@@ -0,0 +1,107 @@
+#ifndef TINY_STREAM_SCANNER_H
+#define TINY_STREAM_SCANNER_H
+
+#include "TinyCommon.h"
+#include "TinyScanner.h"
+#include "TinySimd.h"
+#include <istream>
+#include <vector>
+#include <cstring>
+
+// Scanner that pulls fixed-size chunks from a std::istream instead of
+// holding the whole source in memory. Whitespace and {} comments may span
+// any number of chunks without being buffered; a token that crosses a chunk
+// boundary is completed after the next read. Memory therefore stays at one
+// chunk, growing only if a single token is longer than that.
+//
+// Produces the same tokens as Scanner over the whole input (a leading
+// UTF-8 BOM is skipped). Each token views into the internal buffer and is
+// only valid until the next call to nextToken().
+class StreamScanner : public TokenSource {
+    std::istream& in;
+    std::vector<char> buf;
+    size_t pos = 0;             // next unread byte in buf
+    size_t end = 0;             // end of valid data in buf
+    bool eof = false;           // no more data in the stream
+    bool started = false;       // BOM check done
+    bool inComment = false;     // inside a {} comment that crossed a chunk
+    const SkipKernels* skip = &skipKernels();
+
+    // Drop consumed bytes before 'pos' and read the next chunk after the
+    // bytes still in use. The buffer grows only when it is already full.
+    void refill() {
+        if (pos > 0) {
+            std::memmove(buf.data(), buf.data() + pos, end - pos);
+            end -= pos;
+            pos = 0;
+        }
+        if (end == buf.size()) buf.resize(buf.size() * 2);
+
+        in.read(buf.data() + end, (std::streamsize)(buf.size() - end));
+        size_t got = (size_t)in.gcount();
+        end += got;
+        if (got == 0 || !in) eof = true;
+    }
+
+    Token endOfFile() const {
+        return {SourceView(buf.data() + pos, 0), TokenType::END_OF_FILE};
+    }
+
+public:
+    explicit StreamScanner(std::istream& input, size_t chunkSize = 1 << 16)
+        : in(input), buf(chunkSize > 0 ? chunkSize : 1) {}
+
+    Token nextToken() override {
+        if (!started) {
+            started = true;
+            while (end < 3 && !eof) refill();
+            pos = bomLength(buf.data(), end);
+        }
+
+        while (true) {
+            if (inComment) {
+                size_t stop = skip->findCommentEnd(buf.data(), pos, end);
+                if (stop == end) {
+                    pos = end;
+                    if (eof) return endOfFile();
+                    refill();
+                    continue;
+                }
+                pos = stop;
+                if (buf[pos] == '\0') return endOfFile();
+                pos++;
+                inComment = false;
+                continue;
+            }
+
+            pos = skip->skipSpaces(buf.data(), pos, end);
+            if (pos == end) {
+                if (eof) return endOfFile();
+                refill();
+                continue;
+            }
+            if (buf[pos] == '{') {
+                inComment = true;
+                pos++;
+                continue;
+            }
+
+            // A token starts here; let the DFA scan it within the buffer
+            Scanner scanner(buf.data(), end, pos);
+            Token tok = scanner.nextToken();
+            if (tok.type == TokenType::END_OF_FILE) return endOfFile();
+
+            size_t tokEnd = (size_t)(tok.value.data() - buf.data()) + tok.value.size();
+            if (tokEnd == end && !eof) {
+                // May continue in the next chunk: read more and rescan it
+                refill();
+                continue;
+            }
+
+            pos = tokEnd;
+            return tok;
+        }
+    }
+};
+
+#endif // TINY_STREAM_SCANNER_H
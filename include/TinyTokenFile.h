@@ -0,0 +1,291 @@
+#ifndef TINY_TOKEN_FILE_H
+#define TINY_TOKEN_FILE_H
+
+#include "TinyCommon.h"
+#include "TinyMappedFile.h"
+#include "TinyOutput.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <cstdio>
+
+// Binary token file, the compact alternative to the "value , TYPE" text
+// that tiny_scanner writes. Token values are interned: each distinct text
+// is stored once and tokens refer to it by number, so a loaded file needs
+// no per-token parsing or allocation.
+//
+// Layout (native byte order, checked through 'byteOrder'):
+//   header          TokenFileHeader
+//   types           uint8_t  [tokenCount]      TokenType of each token
+//   (zero padding to a multiple of 4)
+//   ids             uint32_t [tokenCount]      string of each token
+//   stringOffsets   uint32_t [stringCount + 1] start of each string, then the end
+//   stringBytes     char     [stringBytes]     the strings, back to back
+struct TokenFileHeader {
+    char magic[8];          // "TINYTOK1"
+    uint32_t byteOrder;     // 0x01020304 as written
+    uint32_t headerSize;    // sizeof(TokenFileHeader)
+    uint64_t tokenCount;
+    uint64_t stringCount;
+    uint64_t stringBytes;
+    uint64_t reserved;      // 0
+};
+
+static const char kTokenFileMagic[8] = {'T', 'I', 'N', 'Y', 'T', 'O', 'K', '1'};
+
+// True if 'data' starts like a binary token file
+inline bool isTokenFile(const char* data, size_t size) {
+    return size >= sizeof(kTokenFileMagic) && memcmp(data, kTokenFileMagic, sizeof(kTokenFileMagic)) == 0;
+}
+
+// Builds a token file from scanned tokens. Values are copied into the
+// string table as they are added, so tokens from a scanner that reuses its
+// buffer (StreamScanner) can be added one by one.
+//
+// The type and string-id arrays are kept in blocks of kBlock tokens that
+// are spilled to two temporary files (std::tmpfile) as they fill, and
+// copied out behind the header by write(). Memory then grows only with the
+// string table, i.e. with the distinct token texts, not with the token
+// count. If no temporary file can be created the arrays stay in memory.
+class TokenFileWriter {
+    static const size_t kBlock = 1 << 16;
+
+    std::vector<uint8_t> types;          // tokens not yet spilled
+    std::vector<uint32_t> ids;
+    std::FILE* typeSpill = nullptr;      // tokens spilled so far, in order
+    std::FILE* idSpill = nullptr;
+    uint64_t spilled = 0;
+    std::string strings;                 // interned text, back to back
+    std::vector<uint32_t> stringOffsets; // start of each string, then the end
+    std::vector<uint32_t> stringHashes;
+    std::vector<uint32_t> slots;         // open-addressing table: string id + 1, or 0
+
+    static uint32_t hashText(const char* data, size_t size) {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < size; i++) {
+            h = (h ^ (uint8_t)data[i]) * 16777619u;
+        }
+        return h;
+    }
+
+    void grow() {
+        slots.assign(slots.empty() ? 256 : slots.size() * 2, 0);
+        size_t mask = slots.size() - 1;
+        for (uint32_t id = 0; id + 1 < stringOffsets.size(); id++) {
+            size_t slot = stringHashes[id] & mask;
+            while (slots[slot] != 0) slot = (slot + 1) & mask;
+            slots[slot] = id + 1;
+        }
+    }
+
+    uint32_t intern(SourceView text) {
+        uint32_t h = hashText(text.data(), text.size());
+        size_t mask = slots.size() - 1;
+        size_t slot = h & mask;
+        for (; slots[slot] != 0; slot = (slot + 1) & mask) {
+            uint32_t id = slots[slot] - 1;
+            uint32_t begin = stringOffsets[id];
+            if (stringHashes[id] == h && stringOffsets[id + 1] - begin == text.size() &&
+                memcmp(strings.data() + begin, text.data(), text.size()) == 0) {
+                return id;
+            }
+        }
+
+        if (text.size() > UINT32_MAX - strings.size()) {
+            throw std::length_error("TokenFileWriter: string table larger than 4 GiB");
+        }
+        uint32_t id = (uint32_t)stringHashes.size();
+        strings.append(text.data(), text.size());
+        stringOffsets.push_back((uint32_t)strings.size());
+        stringHashes.push_back(h);
+        slots[slot] = id + 1;
+        if (stringHashes.size() * 2 > slots.size()) grow(); // keep the table at most half full
+        return id;
+    }
+
+    // Move the full blocks to the temporary files
+    void spill() {
+        if (!typeSpill) {
+            typeSpill = std::tmpfile();
+            idSpill = typeSpill ? std::tmpfile() : nullptr;
+            if (!idSpill) {
+                if (typeSpill) std::fclose(typeSpill);
+                typeSpill = nullptr;
+                return; // keep growing in memory
+            }
+        }
+        if (std::fwrite(types.data(), 1, types.size(), typeSpill) != types.size() ||
+            std::fwrite(ids.data(), sizeof(uint32_t), ids.size(), idSpill) != ids.size()) {
+            throw std::runtime_error("TokenFileWriter: cannot write temporary file");
+        }
+        spilled += types.size();
+        types.clear();
+        ids.clear();
+    }
+
+    // Copy a temporary file to 'out', leaving it positioned for more writes
+    static void copySpill(std::FILE* file, OutputSink& out) {
+        char block[1 << 14];
+        std::fflush(file);
+        std::rewind(file);
+        size_t n;
+        while ((n = std::fread(block, 1, sizeof(block), file)) > 0) out.write(block, n);
+        bool failed = std::ferror(file) != 0;
+        std::fseek(file, 0, SEEK_END);
+        if (failed) throw std::runtime_error("TokenFileWriter: cannot read temporary file");
+    }
+
+public:
+    TokenFileWriter() : stringOffsets(1, 0) {
+        grow();
+        types.reserve(kBlock);
+        ids.reserve(kBlock);
+    }
+
+    ~TokenFileWriter() {
+        if (typeSpill) std::fclose(typeSpill);
+        if (idSpill) std::fclose(idSpill);
+    }
+
+    TokenFileWriter(const TokenFileWriter&) = delete;
+    TokenFileWriter& operator=(const TokenFileWriter&) = delete;
+
+    void add(const Token& tok) {
+        types.push_back((uint8_t)tok.type);
+        ids.push_back(intern(tok.value));
+        if (types.size() == kBlock) spill();
+    }
+
+    size_t size() const { return (size_t)spilled + types.size(); }
+    size_t stringCount() const { return stringHashes.size(); }
+
+    // Write the whole file; check out.good() after flushing for errors.
+    // Throws std::runtime_error if a temporary file cannot be read back.
+    void write(OutputSink& out) const {
+        uint64_t tokens = spilled + types.size();
+        TokenFileHeader header;
+        memcpy(header.magic, kTokenFileMagic, sizeof(header.magic));
+        header.byteOrder = 0x01020304;
+        header.headerSize = sizeof(TokenFileHeader);
+        header.tokenCount = tokens;
+        header.stringCount = stringHashes.size();
+        header.stringBytes = strings.size();
+        header.reserved = 0;
+
+        out.write((const char*)&header, sizeof(header));
+        if (typeSpill) copySpill(typeSpill, out);
+        out.write((const char*)types.data(), types.size());
+        out.fill('\0', (size_t)(4 - tokens % 4) % 4);
+        if (idSpill) copySpill(idSpill, out);
+        out.write((const char*)ids.data(), ids.size() * sizeof(uint32_t));
+        out.write((const char*)stringOffsets.data(), stringOffsets.size() * sizeof(uint32_t));
+        out.write(strings.data(), strings.size());
+    }
+};
+
+// A token file mapped (or held) in memory. The file is checked once when
+// it is opened; after that every token is an array lookup, and its value
+// views into the file's string table.
+// Throws std::runtime_error if the file cannot be read or is malformed.
+class TokenFile {
+    std::unique_ptr<MappedFile> mapped;
+    size_t count = 0;
+    const uint8_t* types = nullptr;
+    const uint32_t* ids = nullptr;
+    const uint32_t* stringOffsets = nullptr;
+    const char* strings = nullptr;
+
+    void open(const char* data, size_t size) {
+        TokenFileHeader header;
+        if (size < sizeof(header) || !isTokenFile(data, size)) {
+            throw std::runtime_error("Not a binary token file");
+        }
+        memcpy(&header, data, sizeof(header));
+        if (header.byteOrder != 0x01020304 || header.headerSize != sizeof(header)) {
+            throw std::runtime_error("Token file was written on an incompatible machine");
+        }
+        if ((uintptr_t)data % 4 != 0) {
+            throw std::runtime_error("Token file data is not aligned");
+        }
+
+        // Every section must fit, and together fill the file exactly
+        uint64_t available = size - sizeof(header);
+        uint64_t tokens = header.tokenCount;
+        uint64_t stringCount = header.stringCount;
+        if (tokens > available / 5 || stringCount >= available / 4 || header.stringBytes > UINT32_MAX) {
+            throw std::runtime_error("Token file is truncated");
+        }
+        uint64_t typesSize = (tokens + 3) / 4 * 4;
+        uint64_t expected = typesSize + tokens * 4 + (stringCount + 1) * 4 + header.stringBytes;
+        if (expected != available) {
+            throw std::runtime_error("Token file size does not match its header");
+        }
+
+        count = (size_t)tokens;
+        types = reinterpret_cast<const uint8_t*>(data + sizeof(header));
+        ids = reinterpret_cast<const uint32_t*>(data + sizeof(header) + typesSize);
+        stringOffsets = ids + count;
+        strings = reinterpret_cast<const char*>(stringOffsets + stringCount + 1);
+
+        if (stringOffsets[0] != 0 || stringOffsets[stringCount] != header.stringBytes) {
+            throw std::runtime_error("Token file string table is corrupt");
+        }
+        for (uint64_t i = 0; i < stringCount; i++) {
+            if (stringOffsets[i] > stringOffsets[i + 1]) {
+                throw std::runtime_error("Token file string table is corrupt");
+            }
+        }
+        // END_OF_FILE is never stored: the end of the arrays is the end
+        bool ok = true;
+        for (size_t i = 0; i < count; i++) {
+            ok &= types[i] < (uint8_t)TokenType::END_OF_FILE;
+            ok &= ids[i] < stringCount;
+        }
+        if (!ok) {
+            throw std::runtime_error("Token file has an invalid token");
+        }
+    }
+
+public:
+    // Map the file at 'path'
+    explicit TokenFile(const std::string& path) : mapped(new MappedFile(path)) {
+        open(mapped->data(), mapped->size());
+    }
+
+    // Use a file already in memory (4-byte aligned), which must outlive this
+    TokenFile(const char* data, size_t size) { open(data, size); }
+
+    TokenFile(const TokenFile&) = delete;
+    TokenFile& operator=(const TokenFile&) = delete;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    TokenType type(size_t i) const { return TokenType(types[i]); }
+    SourceView value(size_t i) const {
+        uint32_t id = ids[i];
+        return SourceView(strings + stringOffsets[id], stringOffsets[id + 1] - stringOffsets[id]);
+    }
+    Token operator[](size_t i) const { return Token(value(i), type(i)); }
+
+    const uint8_t* typeData() const { return types; }
+};
+
+// TokenSource reading a TokenFile front to back
+class TokenFileSource : public TokenSource {
+    const TokenFile& file;
+    size_t index = 0;
+
+public:
+    explicit TokenFileSource(const TokenFile& tokenFile) : file(tokenFile) {}
+
+    Token nextToken() override {
+        if (index < file.size()) return file[index++];
+        return {SourceView(), TokenType::END_OF_FILE};
+    }
+};
+
+#endif // TINY_TOKEN_FILE_H
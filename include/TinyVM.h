@@ -0,0 +1,157 @@
+#ifndef TINY_VM_H
+#define TINY_VM_H
+
+#include "TinyBytecode.h"
+#include "TinyInterpreter.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+// Computed goto ("labels as values") is a GCC/Clang extension; other
+// compilers, or builds with TINY_NO_COMPUTED_GOTO defined, use a switch
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(TINY_NO_COMPUTED_GOTO)
+#define TINY_VM_COMPUTED_GOTO 1
+#else
+#define TINY_VM_COMPUTED_GOTO 0
+#endif
+
+// Runs Bytecode with the semantics of Interpreter: 64-bit wrapping
+// arithmetic, division truncating toward zero, and the same runtime errors.
+//
+// With computed goto every handler ends in its own indirect jump to the
+// next handler, so each opcode has its own branch-prediction history
+// instead of all of them sharing the one jump of a switch.
+class VirtualMachine {
+public:
+    struct RunResult {
+        bool success = false;
+        std::string error;
+        uint64_t instructions = 0; // instructions executed
+    };
+
+private:
+    const Bytecode& program;
+    std::vector<int64_t> regs;
+
+public:
+    // 'code' must outlive the machine
+    explicit VirtualMachine(const Bytecode& code) : program(code), regs(code.registerCount(), 0) {}
+
+    VirtualMachine(const VirtualMachine&) = delete;
+    VirtualMachine& operator=(const VirtualMachine&) = delete;
+
+    // Variables by slot, with their values after the last run
+    size_t variableCount() const { return program.names.size(); }
+    const std::string& variableName(size_t slot) const { return program.names[slot]; }
+    int64_t variable(size_t slot) const { return regs[slot]; }
+
+    // Run the program from the start, with all variables at 0
+    RunResult run(ValueInput& input, ValueOutput& output) {
+        RunResult result;
+        size_t variables = program.names.size();
+        std::fill(regs.begin(), regs.end(), 0);
+        std::copy(program.constants.begin(), program.constants.end(), regs.begin() + variables);
+
+        int64_t* r = regs.data();
+        const Instruction* code = program.code.data();
+        const Instruction* pc = code;
+        uint64_t executed = 0;
+        std::string error;
+        int64_t value;
+
+#if TINY_VM_COMPUTED_GOTO
+        // In Opcode order
+        static const void* const handlers[] = {
+            &&op_MOVE, &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_LESS, &&op_EQUAL,
+            &&op_READ, &&op_WRITE, &&op_JUMP, &&op_JUMP_IF_ZERO, &&op_JUMP_IF_NOT_LESS,
+            &&op_JUMP_IF_NOT_EQUAL, &&op_HALT
+        };
+#define TINY_VM_OP(name) op_##name:
+#define TINY_VM_NEXT() do { executed++; goto *handlers[(unsigned)pc->op]; } while (0)
+        TINY_VM_NEXT();
+#else
+#define TINY_VM_OP(name) case Opcode::name:
+#define TINY_VM_NEXT() continue
+        for (;;) {
+        executed++;
+        switch (pc->op) {
+#endif
+        TINY_VM_OP(MOVE)
+            r[pc->a] = r[pc->b];
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(ADD)
+            r[pc->a] = (int64_t)((uint64_t)r[pc->b] + (uint64_t)r[pc->c]);
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(SUB)
+            r[pc->a] = (int64_t)((uint64_t)r[pc->b] - (uint64_t)r[pc->c]);
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(MUL)
+            r[pc->a] = (int64_t)((uint64_t)r[pc->b] * (uint64_t)r[pc->c]);
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(DIV)
+            value = r[pc->c];
+            if (value == 0) {
+                error = "Division by zero";
+                goto stop;
+            }
+            // INT64_MIN / -1 wraps
+            r[pc->a] = value == -1 ? (int64_t)(0 - (uint64_t)r[pc->b]) : r[pc->b] / value;
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(LESS)
+            r[pc->a] = r[pc->b] < r[pc->c];
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(EQUAL)
+            r[pc->a] = r[pc->b] == r[pc->c];
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(READ)
+            output.flush();
+            if (!input.readValue(value)) {
+                error = "read " + program.names[pc->a] + ": no more input";
+                goto stop;
+            }
+            r[pc->a] = value;
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(WRITE)
+            output.writeValue(r[pc->a]);
+            pc++;
+            TINY_VM_NEXT();
+        TINY_VM_OP(JUMP)
+            pc = code + pc->a;
+            TINY_VM_NEXT();
+        TINY_VM_OP(JUMP_IF_ZERO)
+            pc = r[pc->b] == 0 ? code + pc->a : pc + 1;
+            TINY_VM_NEXT();
+        TINY_VM_OP(JUMP_IF_NOT_LESS)
+            pc = r[pc->b] < r[pc->c] ? pc + 1 : code + pc->a;
+            TINY_VM_NEXT();
+        TINY_VM_OP(JUMP_IF_NOT_EQUAL)
+            pc = r[pc->b] == r[pc->c] ? pc + 1 : code + pc->a;
+            TINY_VM_NEXT();
+        TINY_VM_OP(HALT)
+            goto stop;
+#if !TINY_VM_COMPUTED_GOTO
+        }
+        }
+#endif
+#undef TINY_VM_OP
+#undef TINY_VM_NEXT
+
+    stop:
+        output.flush();
+        result.instructions = executed;
+        result.success = error.empty();
+        result.error = error;
+        return result;
+    }
+};
+
+#endif // TINY_VM_H
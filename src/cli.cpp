@@ -1,74 +1,336 @@
 #include "../include/TinyScanner.h"
 #include "../include/TinyParser.h"
+#include "../include/TinyParallelParser.h"
+#include "../include/TinyMappedFile.h"
+#include "../include/TinyOutput.h"
+#include "../include/TinyCache.h"
+#include "../include/TinyTokenFile.h"
+#include "../include/TinyTokenText.h"
+#include "../include/TinyInterpreter.h"
+#include "../include/TinyBytecode.h"
+#include "../include/TinyVM.h"
+#include "../include/TinyJit.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <memory>
+#include <chrono>
 
 using namespace std;
 
+// Part of every cache key. Bump the version with any change to what a
+// compile outputs (tokens, tree listing, drawings, messages), so cached
+// output from an older build is not reused; the entry layout has its own
+// number in TinyCache.h.
+static const char kToolVersion[] = "tiny_compiler 1.0, cache format " TINY_CACHE_FORMAT;
+
 void printUsage(const char* progName) {
     cout << "TINY Language Compiler - Scanner & Parser\n";
     cout << "==========================================\n\n";
     cout << "Usage:\n";
-    cout << "  " << progName << " <input_file> [output_file]\n\n";
+    cout << "  " << progName << " [options] <input_file> [output_file]\n\n";
     cout << "Arguments:\n";
     cout << "  <input_file>    TINY source code file to compile\n";
     cout << "  [output_file]   Optional: Output file for syntax tree (default: <input>.tree)\n";
+    cout << "\nOptions:\n";
+    cout << "  --mmap          Memory-map the input file and scan it in place\n";
+    cout << "  --stream        Parse tokens as they are scanned (no token listing)\n";
+    cout << "  --all-errors    Keep parsing after a syntax error and report every error\n";
+    cout << "  --threads N     Parse top-level statements on N threads (0 = one per core; not with --stream)\n";
+    cout << "  --cache DIR     Reuse results of earlier compiles of the same source from DIR\n";
+    cout << "  --tokens        Input is a token file written by tiny_scanner (text or --binary)\n";
+    cout << "  --run           Run the program if it is accepted (read from stdin, write to stdout)\n";
+    cout << "  --run-tree      Same, with the tree-walking interpreter instead of the bytecode VM\n";
+    cout << "  --jit           Same, as native x86-64 code (the bytecode VM on other hosts)\n";
+    cout << "  --disasm        List the program's bytecode\n";
+    cout << "  --bench         Time the program under both engines on the same input (stdin)\n";
     cout << "\nExample:\n";
     cout << "  " << progName << " input.txt\n";
     cout << "  " << progName << " input.txt output.tree\n";
+    cout << "  " << progName << " --mmap input.txt\n";
 }
 
+struct CompileOptions {
+    bool useMmap = false;
+    bool streamTokens = false;
+    bool allErrors = false;
+    unsigned threads = 1;
+    string cacheDir;
+    bool tokenFile = false;
+    bool run = false;
+    bool treeWalk = false;
+    bool jit = false;
+    bool disassemble = false;
+    bool bench = false;
+};
+
 string readSourceFile(const string& filename) {
     ifstream file(filename, ios::in | ios::binary);
     if (!file) {
         throw runtime_error("Cannot open file: " + filename);
     }
 
-    string src((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    // Read in one block; the scanner itself skips a UTF-8 BOM and treats
+    // CR as whitespace, so no fix-up passes are needed here
+    file.seekg(0, ios::end);
+    streamoff size = file.tellg();
+    file.seekg(0, ios::beg);
+
+    string src(size > 0 ? (size_t)size : 0, '\0');
+    if (!src.empty()) file.read(&src[0], (streamsize)src.size());
     file.close();
 
-    // Remove UTF-8 BOM if present
-    if (src.size() >= 3 &&
-        (unsigned char)src[0] == 0xEF &&
-        (unsigned char)src[1] == 0xBB &&
-        (unsigned char)src[2] == 0xBF) {
-        src.erase(0, 3);
+    return src;
+}
+
+// Discards a run's output but keeps a checksum of it, for --bench
+class ChecksumOutput : public ValueOutput {
+public:
+    uint64_t count = 0;
+    uint64_t checksum = 0;
+
+    void writeValue(int64_t value) override {
+        count++;
+        checksum = hashMix(checksum ^ (uint64_t)value) + count;
     }
+};
 
-    // Normalize newlines (Windows CRLF -> LF)
-    replace(src.begin(), src.end(), '\r', '\n');
+// Run with the tree walker (--run-tree), as native code (--jit) or on the
+// bytecode VM; false on a runtime error
+bool runProgram(const SyntaxTree& ast, const Bytecode& code, const CompileOptions& options) {
+    StreamValueInput input(cin);
+    StreamSink sink(cout);
+    SinkValueOutput output(sink);
+    if (options.jit) {
+        JitProgram native;
+        if (native.compile(code)) {
+            JitProgram::RunResult run = native.run(input, output);
+            if (run.success) {
+                cout << "Program finished (native code)\n";
+            } else {
+                cout << "  Runtime error: " << run.error << "\n";
+            }
+            return run.success;
+        }
+        cout << "  " << native.error() << "; using the bytecode VM\n";
+    }
+    if (options.treeWalk) {
+        Interpreter interpreter(ast);
+        Interpreter::RunResult run = interpreter.run(input, output);
+        if (run.success) {
+            cout << "Program finished (" << run.statements << " statements executed)\n";
+        } else {
+            cout << "  Runtime error: " << run.error << "\n";
+        }
+        return run.success;
+    }
+    VirtualMachine vm(code);
+    VirtualMachine::RunResult run = vm.run(input, output);
+    if (run.success) {
+        cout << "Program finished (" << run.instructions << " instructions executed)\n";
+    } else {
+        cout << "  Runtime error: " << run.error << "\n";
+    }
+    return run.success;
+}
 
-    return src;
+// Run under every engine on the whole of stdin and compare; false if the
+// runs disagree or stop with a runtime error
+bool benchmarkRun(const SyntaxTree& ast, const Bytecode& code) {
+    typedef chrono::steady_clock Clock;
+    stringstream stdinText;
+    stdinText << cin.rdbuf();
+    string inputText = stdinText.str();
+
+    istringstream treeIn(inputText);
+    StreamValueInput treeInput(treeIn);
+    ChecksumOutput treeOutput;
+    Interpreter interpreter(ast);
+    Clock::time_point start = Clock::now();
+    Interpreter::RunResult treeRun = interpreter.run(treeInput, treeOutput);
+    double treeSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+    istringstream vmIn(inputText);
+    StreamValueInput vmInput(vmIn);
+    ChecksumOutput vmOutput;
+    VirtualMachine vm(code);
+    start = Clock::now();
+    VirtualMachine::RunResult vmRun = vm.run(vmInput, vmOutput);
+    double vmSeconds = chrono::duration<double>(Clock::now() - start).count();
+
+    bool same = treeRun.success == vmRun.success && treeRun.error == vmRun.error &&
+                treeOutput.count == vmOutput.count && treeOutput.checksum == vmOutput.checksum;
+    cout << "--- Benchmark (output discarded) ---\n";
+    cout << "  Tree walker:  " << treeSeconds * 1000 << " ms, " << treeRun.statements << " statements\n";
+    cout << "  Bytecode VM:  " << vmSeconds * 1000 << " ms, " << vmRun.instructions << " instructions";
+    if (vmSeconds > 0) cout << " (" << treeSeconds / vmSeconds << "x)";
+    cout << "\n";
+
+    // Native code, where this host supports it; translation time included
+    JitProgram native;
+    istringstream jitIn(inputText);
+    StreamValueInput jitInput(jitIn);
+    ChecksumOutput jitOutput;
+    start = Clock::now();
+    if (native.compile(code)) {
+        JitProgram::RunResult jitRun = native.run(jitInput, jitOutput);
+        double jitSeconds = chrono::duration<double>(Clock::now() - start).count();
+        same = same && jitRun.success == vmRun.success && jitRun.error == vmRun.error &&
+               jitOutput.count == vmOutput.count && jitOutput.checksum == vmOutput.checksum;
+        cout << "  Native code:  " << jitSeconds * 1000 << " ms, " << native.codeSize() << " bytes";
+        if (jitSeconds > 0) cout << " (" << treeSeconds / jitSeconds << "x)";
+        cout << "\n";
+    } else {
+        cout << "  Native code:  " << native.error() << "\n";
+    }
+    cout << "  " << vmOutput.count << " values written; outputs " << (same ? "match" : "DIFFER") << "\n";
+    if (!vmRun.success) cout << "  Runtime error: " << vmRun.error << "\n";
+    return same && vmRun.success;
 }
 
-void compileFile(const string& inputFile, const string& outputFile) {
+// False if the program was run (--run, --bench) and stopped with a runtime error
+bool compileFile(const string& inputFile, const string& outputFile, const CompileOptions& options) {
     cout << "\n=== TINY Language Compiler ===\n";
     cout << "Input: " << inputFile << "\n";
     cout << "Output: " << outputFile << "\n\n";
 
     try {
-        // Step 1: Read source code
-        cout << "Step 1: Reading source file...\n";
-        string sourceCode = readSourceFile(inputFile);
-        cout << "--- Source Code ---\n";
-        cout << sourceCode << "\n";
-
-        // Step 2: Scan (Lexical Analysis)
-        cout << "\nStep 2: Scanning (Lexical Analysis)...\n";
-        Scanner scanner(sourceCode);
-        vector<Token> tokens = scanner.scanAll();
-
-        cout << "--- Tokens Generated ---\n";
-        for (const auto& tok : tokens) {
-            cout << tok.value << " , " << tokenTypeToString(tok.type) << "\n";
+        // Step 1: Read source code (or map it, with --mmap), or map the
+        // tokens of an earlier scan (--tokens)
+        string sourceCode;
+        unique_ptr<MappedFile> mapped;
+        unique_ptr<TokenFile> tokenFile;
+        SourceView source;
+        TokenBuffer tokens;
+        if (options.tokenFile) {
+            // A binary token file is used in place; a text dump ("value ,
+            // TYPE" lines) is read into the token list
+            cout << "Step 1: Mapping token file...\n";
+            mapped.reset(new MappedFile(inputFile));
+            if (isTokenFile(mapped->data(), mapped->size())) {
+                tokenFile.reset(new TokenFile(mapped->data(), mapped->size()));
+            } else {
+                TokenTextReader reader(mapped->data(), mapped->size());
+                if (!reader.read(tokens)) {
+                    throw runtime_error("Unknown token type '" + reader.unknownType().str() +
+                                        "' on line " + to_string(reader.unknownTypeLine()));
+                }
+            }
+        } else {
+            cout << "Step 1: Reading source file...\n";
+            if (options.useMmap) {
+                mapped.reset(new MappedFile(inputFile));
+                source = SourceView(mapped->data(), mapped->size());
+            } else {
+                sourceCode = readSourceFile(inputFile);
+                source = SourceView(sourceCode.data(), sourceCode.size());
+            }
+            size_t bom = bomLength(source.data(), source.size());
+            cout << "--- Source Code ---\n";
+            cout << SourceView(source.data() + bom, source.size() - bom) << "\n";
         }
-        cout << "Total tokens: " << tokens.size() << "\n";
 
-        // Step 3: Parse (Syntax Analysis)
-        cout << "\nStep 3: Parsing (Syntax Analysis)...\n";
         TinyParser parser;
-        auto result = parser.parse(tokens);
+        parser.setErrorRecovery(options.allErrors);
+        TinyParser::ParseResult result;
+        bool runFailed = false;
+
+        // With --cache, look for an earlier compile of the same bytes by
+        // the same version of this tool with the same output options (token
+        // files are not cached: they are already the output of a scan)
+        unique_ptr<CompileCache> cache;
+        ContentHash key;
+        CacheEntry cached;
+        bool cacheHit = false;
+        if (!options.cacheDir.empty() && !options.tokenFile) {
+            cache.reset(new CompileCache(options.cacheDir));
+            string salt = string(kToolVersion) + (options.allErrors ? "|all-errors" : "") +
+                          (options.streamTokens ? "|stream" : "");
+            key = hashBytes(source.data(), source.size(), hashString(salt));
+            cacheHit = cache->load(key, source, cached);
+        }
+
+        if (cacheHit) {
+            // Steps 2+3: tokens, tree and drawings come from the cache
+            cout << "\nStep 2+3: Loaded from cache (" << cache->pathFor(key) << ")\n";
+            if (cached.hasTokens) {
+                cout << "--- Tokens Generated ---\n";
+                for (size_t i = 0; i < cached.tokens.size(); i++) {
+                    cout << cached.tokens.value(i) << " , " << tokenTypeToString(cached.tokens.type(i)) << "\n";
+                }
+                cout << "Total tokens: " << cached.tokens.size() << "\n";
+            }
+            result.success = cached.success;
+            result.errors.swap(cached.errors);
+            result.ast.swap(cached.ast);
+        } else if (tokenFile) {
+            // Steps 2+3: the tokens were scanned earlier; parse them in place
+            cout << "\nStep 2: Tokens from file\n";
+            if (!options.streamTokens) {
+                cout << "--- Tokens Generated ---\n";
+                for (size_t i = 0; i < tokenFile->size(); i++) {
+                    cout << tokenFile->value(i) << " , " << tokenTypeToString(tokenFile->type(i)) << "\n";
+                }
+                cout << "Total tokens: " << tokenFile->size() << "\n";
+            }
+
+            cout << "\nStep 3: Parsing (Syntax Analysis)...\n";
+            if (options.threads != 1) cout << "  --threads is not used for binary token files; parsing on one thread\n";
+            TokenFileSource tokenSource(*tokenFile);
+            parser.parse(tokenSource, result);
+        } else if (options.streamTokens && !options.tokenFile) {
+            // Steps 2+3: the parser pulls tokens from the scanner as it goes
+            Scanner scanner(source.data(), source.size());
+            cout << "\nStep 2+3: Scanning and parsing in one pass...\n";
+            result = parser.parse(scanner);
+        } else {
+            // Step 2: Scan (Lexical Analysis), unless a token dump was read
+            if (options.tokenFile) {
+                cout << "\nStep 2: Tokens from file\n";
+            } else {
+                cout << "\nStep 2: Scanning (Lexical Analysis)...\n";
+                Scanner scanner(source.data(), source.size());
+                scanner.scanAll(tokens);
+            }
+
+            if (!options.streamTokens) {
+                cout << "--- Tokens Generated ---\n";
+                for (size_t i = 0; i < tokens.size(); i++) {
+                    cout << tokens.value(i) << " , " << tokenTypeToString(tokens.type(i)) << "\n";
+                }
+                cout << "Total tokens: " << tokens.size() << "\n";
+            }
+
+            // Step 3: Parse (Syntax Analysis)
+            cout << "\nStep 3: Parsing (Syntax Analysis)...\n";
+            if (options.threads != 1) {
+                ParallelParser parallel(tokens);
+                parallel.setErrorRecovery(options.allErrors);
+                result = parallel.parse(options.threads);
+            } else {
+                result = parser.parse(tokens);
+            }
+        }
+
+        // Rendered artifacts are kept as text when they go into the cache
+        // (or come out of it); otherwise they are streamed to their files
+        if (cache && !cacheHit && result.success) {
+            StringSink treeOut(cached.treeText);
+            result.ast.writeTree(treeOut);
+            StringSink dotOut(cached.dot);
+            result.ast.writeGraphViz(dotOut);
+            StringSink svgOut(cached.svg);
+            TreeLayout(result.ast).writeSVG(svgOut);
+        }
+        bool haveText = cache != nullptr;
+        auto writeTreeText = [&](ostream& out) {
+            if (haveText) {
+                out << cached.treeText;
+            } else {
+                StreamSink sink(out);
+                result.ast.writeTree(sink);
+            }
+        };
 
         // Step 4: Report Results
         cout << "\n===========================================\n";
@@ -76,9 +338,10 @@ void compileFile(const string& inputFile, const string& outputFile) {
             cout << "SUCCESS: Input ACCEPTED by TINY language\n";
             cout << "===========================================\n\n";
 
+            // The tree listing is streamed out, never built as one string
+            // (unless it is cached)
             cout << "--- Syntax Tree ---\n";
-            string treeStr = parser.getTreeString(result.ast);
-            cout << treeStr;
+            writeTreeText(cout);
 
             // Save text tree to output file
             ofstream outFile(outputFile);
@@ -88,29 +351,65 @@ void compileFile(const string& inputFile, const string& outputFile) {
                 outFile << "Input File: " << inputFile << "\n\n";
                 outFile << "Result: ACCEPTED\n\n";
                 outFile << "Syntax Tree:\n";
-                outFile << treeStr;
+                writeTreeText(outFile);
                 outFile.close();
                 cout << "\n Syntax tree saved to: " << outputFile << "\n";
             }
 
-            // Generate PNG visualization
-            cout << "\nStep 4: Generating visual tree (PNG)...\n";
-            string pngFile = outputFile.substr(0, outputFile.find_last_of('.')) + ".png";
-            if (parser.generateTreePNG(result.ast, pngFile)) {
-                cout << "  Visual tree saved to: " << pngFile << "\n";
-                cout << "  (DOT source saved to: " << pngFile << ".dot)\n";
+            // Draw the tree in-process, no GraphViz needed
+            cout << "\nStep 4: Generating visual tree (SVG)...\n";
+            string baseName = outputFile.substr(0, outputFile.find_last_of('.'));
+            string svgFile = baseName + ".svg";
+            bool svgWritten;
+            if (haveText) {
+                ofstream svgOut(svgFile, ios::out | ios::binary);
+                svgOut << cached.svg;
+                svgWritten = (bool)svgOut;
             } else {
-                cout << "  Warning: Could not generate PNG image.\n";
+                svgWritten = parser.generateTreeSVG(result.ast, svgFile);
+            }
+            if (svgWritten) {
+                cout << "  Visual tree saved to: " << svgFile << "\n";
+            } else {
+                cout << "  Warning: Could not write " << svgFile << "\n";
+            }
 
+            // DOT source as well, for rendering with GraphViz
+            string dotFile = baseName + ".dot";
+            ofstream dotOut(dotFile);
+            if (dotOut) {
+                if (haveText) {
+                    dotOut << cached.dot;
+                } else {
+                    StreamSink out(dotOut);
+                    result.ast.writeGraphViz(out);
+                }
+                dotOut.close();
+                cout << "  DOT source saved to: " << dotFile << "\n";
+            }
 
-                // Save DOT file anyway
-                string dotFile = pngFile + ".dot";
-                ofstream dotOut(dotFile);
-                if (dotOut) {
-                    dotOut << parser.getTreeDot(result.ast);
-                    dotOut.close();
-                    cout << "  DOT file saved to: " << dotFile << "\n";
-                    cout << "  You can manually convert it: dot -Tpng " << dotFile << " -o " << pngFile << "\n";
+            // Step 5: Compile to bytecode, then list, run or time it
+            if (options.run || options.disassemble || options.bench) {
+                cout << "\nStep 5: Compiling to bytecode...\n";
+                Bytecode code;
+                BytecodeCompiler compiler;
+                if (!compiler.compile(result.ast, code)) {
+                    cout << "  Error: " << compiler.error() << "\n";
+                    runFailed = true;
+                } else {
+                    cout << "  " << code.code.size() << " instructions, " << code.registerCount() << " registers\n";
+                    if (options.disassemble) {
+                        cout << "--- Bytecode ---\n";
+                        StreamSink sink(cout);
+                        code.disassemble(sink);
+                    }
+                    if (options.bench) {
+                        cout << "\nStep 6: Timing the program...\n";
+                        runFailed = !benchmarkRun(result.ast, code);
+                    } else if (options.run) {
+                        cout << "\nStep 6: Running program...\n";
+                        runFailed = !runProgram(result.ast, code, options);
+                    }
                 }
             }
         } else {
@@ -138,6 +437,18 @@ void compileFile(const string& inputFile, const string& outputFile) {
             }
         }
 
+        if (cache && !cacheHit) {
+            cached.success = result.success;
+            cached.hasTokens = !options.streamTokens;
+            cached.tokens = std::move(tokens);
+            cached.ast.swap(result.ast);
+            cached.errors.swap(result.errors);
+            if (!cache->store(key, source, cached)) {
+                cout << "\n  Warning: Could not write cache entry " << cache->pathFor(key) << "\n";
+            }
+        }
+
+        return !runFailed;
     } catch (const exception& e) {
         cerr << "\nFATAL ERROR: " << e.what() << "\n";
         throw;
@@ -150,20 +461,67 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    string inputFile = argv[1];
+    CompileOptions options;
+    vector<string> positional;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--mmap") {
+            options.useMmap = true;
+        } else if (arg == "--stream") {
+            options.streamTokens = true;
+        } else if (arg == "--all-errors") {
+            options.allErrors = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = (unsigned)atoi(argv[++i]);
+        } else if (arg == "--cache" && i + 1 < argc) {
+            options.cacheDir = argv[++i];
+        } else if (arg == "--tokens") {
+            options.tokenFile = true;
+        } else if (arg == "--run") {
+            options.run = true;
+        } else if (arg == "--run-tree") {
+            options.run = true;
+            options.treeWalk = true;
+        } else if (arg == "--jit") {
+            options.run = true;
+            options.jit = true;
+        } else if (arg == "--disasm") {
+            options.disassemble = true;
+        } else if (arg == "--bench") {
+            options.bench = true;
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            cerr << "Unknown option: " << arg << "\n\n";
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (options.streamTokens && options.threads != 1) {
+        // The streamed parse pulls tokens one at a time; there is no token
+        // list to cut into segments
+        cerr << "--threads cannot be combined with --stream\n\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    string inputFile = positional[0];
     string outputFile;
     
     // Determine output file
-    if (argc >= 3) {
-        outputFile = argv[2];
+    if (positional.size() >= 2) {
+        outputFile = positional[1];
     } else {
         // Default output file: input filename + .tree extension
         outputFile = inputFile + ".tree";
     }
 
     try {
-        compileFile(inputFile, outputFile);
-        return 0;
+        return compileFile(inputFile, outputFile, options) ? 0 : 1;
     } catch (const exception& e) {
         return 1;
     }
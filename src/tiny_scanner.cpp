@@ -1,57 +1,122 @@
 // Legacy standalone scanner - outputs tokens to a file
 // For the integrated compiler, use cli.cpp instead
 
-#include "../include/TinyScanner.h"
+#include "../include/TinyStreamScanner.h"
+#include "../include/TinyMappedFile.h"
+#include "../include/TinyParallelScanner.h"
+#include "../include/TinyTokenFile.h"
 #include <iostream>
 #include <fstream>
-#include <algorithm>
+#include <memory>
+#include <cstdlib>
 
 using namespace std;
 
+// Write a token as "value , TYPE" on its own line
+void writeToken(ostream& out, const Token& tok) {
+    out << tok.value << " , " << tokenTypeToString(tok.type) << "\n";
+}
+
+// Or collect it for a binary token file
+void writeToken(TokenFileWriter& out, const Token& tok) {
+    out.add(tok);
+}
+
+template <class TokenScanner, class Output>
+void writeTokens(TokenScanner& scanner, Output& out) {
+    while (true) {
+        Token tok = scanner.nextToken();
+        if (tok.type == TokenType::END_OF_FILE) break;
+        writeToken(out, tok);
+    }
+}
+
+template <class Output>
+void scanTo(Output& out, unsigned threads, MappedFile* mapped, istream& fin) {
+    if (threads != 1) {
+        ParallelScanner scanner(mapped->data(), mapped->size());
+        for (const Token& tok : scanner.scanAll(threads)) {
+            writeToken(out, tok);
+        }
+    } else if (mapped) {
+        Scanner scanner(mapped->data(), mapped->size());
+        writeTokens(scanner, out);
+    } else {
+        StreamScanner scanner(fin);
+        writeTokens(scanner, out);
+    }
+}
+
 int main(int argc, char **argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
 
-    if (argc < 3) {
-        cerr << "Usage: tiny_scanner.exe <input_file> <output_file>\n";
-        return 1;
+    bool useMmap = false;
+    bool binary = false;
+    unsigned threads = 1;
+    int argi = 1;
+    while (argi < argc && string(argv[argi]).compare(0, 2, "--") == 0) {
+        string opt = argv[argi++];
+        if (opt == "--mmap") {
+            useMmap = true;
+        } else if (opt == "--binary") {
+            binary = true;
+        } else if (opt == "--threads" && argi < argc) {
+            threads = (unsigned)atoi(argv[argi++]); // 0 = one per core
+            useMmap = true;
+        } else {
+            argi = argc; // unknown option: show usage
+        }
     }
 
-    string inpath = argv[1];
-    string outpath = argv[2];
-
-    // Read input file into a string
-    ifstream fin(inpath, ios::in | ios::binary);
-    if (!fin) {
-        cerr << "Error: cannot open input file: " << inpath << "\n";
-        return 2;
+    if (argc - argi < 2) {
+        cerr << "Usage: tiny_scanner.exe [--mmap] [--threads N] [--binary] <input_file> <output_file>\n";
+        return 1;
     }
 
-    string src((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
-    fin.close();
+    string inpath = argv[argi];
+    string outpath = argv[argi + 1];
 
-    // remove UTF-8 BOM if present
-    if (src.size() >= 3 &&
-        (unsigned char)src[0] == 0xEF &&
-        (unsigned char)src[1] == 0xBB &&
-        (unsigned char)src[2] == 0xBF) {
-        src.erase(0, 3);
+    // By default scan the input in fixed-size chunks, so memory use does not
+    // grow with the file size; --mmap scans the mapped file in place instead,
+    // and --threads splits the mapped file across worker threads
+    ifstream fin;
+    unique_ptr<MappedFile> mapped;
+    if (useMmap) {
+        try {
+            mapped.reset(new MappedFile(inpath));
+        } catch (const exception& e) {
+            cerr << "Error: " << e.what() << "\n";
+            return 2;
+        }
+    } else {
+        fin.open(inpath, ios::in | ios::binary);
+        if (!fin) {
+            cerr << "Error: cannot open input file: " << inpath << "\n";
+            return 2;
+        }
     }
 
-    // normalize newlines (Windows CRLF -> LF)
-    replace(src.begin(), src.end(), '\r', '\n');
-
-    Scanner scanner(src);
-    ofstream fout(outpath);
+    // --binary writes a token file (include/TinyTokenFile.h) that
+    // tiny_compiler --tokens can map and parse without re-reading text
+    ofstream fout(outpath, binary ? ios::out | ios::binary : ios::out);
     if (!fout) {
         cerr << "Error: cannot open output file: " << outpath << "\n";
         return 3;
     }
 
-    while (true) {
-        Token tok = scanner.nextToken();
-        if (tok.type == TokenType::END_OF_FILE) break;
-        fout << tok.value << " , " << tokenTypeToString(tok.type) << "\n";
+    if (binary) {
+        TokenFileWriter writer;
+        scanTo(writer, threads, mapped.get(), fin);
+        StreamSink sink(fout);
+        writer.write(sink);
+        sink.flush();
+        if (!sink.good()) {
+            cerr << "Error: cannot write output file: " << outpath << "\n";
+            return 3;
+        }
+    } else {
+        scanTo(fout, threads, mapped.get(), fin);
     }
 
     fout.close();
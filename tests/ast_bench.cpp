@@ -0,0 +1,119 @@
+// Syntax tree build rate and size.
+//
+//   ast_bench [megabytes]
+//
+// Parses a generated program of about 'megabytes' MB (5 by default) of
+// nested if/repeat statements, assignments, reads and writes, and reports
+// nodes per second and bytes per node (SyntaxTree::bytesUsed() over the
+// node count), best of 5 parses, both into a fresh ParseResult each time
+// and into one that is reused. Freeing a tree is timed as well. Scanning
+// is not included. Not part of 'make test'; run with 'make bench'.
+
+#include "../include/TinyScanner.h"
+#include "../include/TinyParser.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+static double since(Clock::time_point start) {
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+static string expression(int depth) {
+    static const char* const leaves[] = {"x", "y", "count", "1", "42", "7"};
+    if (depth > 2 || below(3) == 0) return leaves[below(6)];
+    static const char* const ops[] = {" + ", " - ", " * ", " / "};
+    string e = expression(depth + 1) + ops[below(4)] + expression(depth + 1);
+    return below(4) == 0 ? "(" + e + ")" : e;
+}
+
+// 'count' statements separated by ';', nested up to depth 4; at least one,
+// and no more once 'size' bytes are written
+static void statements(string& s, int depth, size_t count, size_t size) {
+    for (size_t i = 0; i < count && (i == 0 || s.size() < size); i++) {
+        if (i > 0) s += ";\n";
+        s.append((size_t)depth * 2, ' ');
+        size_t r = below(10);
+        if (r == 0 && depth < 4) {
+            s += "if " + expression(0) + " < " + expression(0) + " then\n";
+            statements(s, depth + 1, below(4) + 1, size);
+            if (below(2) == 0) {
+                s += "\n" + string((size_t)depth * 2, ' ') + "else\n";
+                statements(s, depth + 1, below(3) + 1, size);
+            }
+            s += "\n" + string((size_t)depth * 2, ' ') + "end";
+        } else if (r == 1 && depth < 4) {
+            s += "repeat\n";
+            statements(s, depth + 1, below(4) + 1, size);
+            s += "\n" + string((size_t)depth * 2, ' ') + "until x = " + expression(0);
+        } else if (r == 2) {
+            s += "read x";
+        } else if (r == 3) {
+            s += "write " + expression(0);
+        } else {
+            s += "x := " + expression(0);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 5;
+    size_t size = megabytes << 20;
+
+    string source;
+    source.reserve(size + 4096);
+    statements(source, 0, (size_t)-1, size);
+    vector<Token> tokens = Scanner(source.data(), source.size()).scanAll();
+
+    TinyParser parser;
+    double fresh = 1e30, reused = 1e30, freed = 1e30;
+    size_t nodes = 0, bytes = 0;
+    TinyParser::ParseResult kept;
+    for (int pass = 0; pass < 5; pass++) {
+        Clock::time_point start = Clock::now();
+        TinyParser::ParseResult* result = new TinyParser::ParseResult(parser.parse(tokens));
+        double seconds = since(start);
+        if (seconds < fresh) fresh = seconds;
+        if (!result->success) {
+            fprintf(stderr, "ast_bench: the generated program does not parse\n");
+            return 1;
+        }
+        nodes = result->ast.size();
+        bytes = result->ast.bytesUsed();
+
+        start = Clock::now();
+        delete result;
+        seconds = since(start);
+        if (seconds < freed) freed = seconds;
+
+        start = Clock::now();
+        parser.parse(tokens.data(), tokens.size(), kept);
+        seconds = since(start);
+        if (seconds < reused) reused = seconds;
+    }
+
+    printf("%zu bytes, %zu tokens, %zu nodes, %.1f bytes/node (%zu-byte node + %zu-byte child index)\n",
+           source.size(), tokens.size(), nodes, (double)bytes / nodes, sizeof(ASTNode), sizeof(NodeId));
+    printf("  fresh result:  %8.1f ms, %6.2f M nodes/s\n", fresh * 1000, nodes / fresh / 1e6);
+    printf("  reused result: %8.1f ms, %6.2f M nodes/s\n", reused * 1000, nodes / reused / 1e6);
+    printf("  free a tree:   %8.2f ms\n", freed * 1000);
+    return 0;
+}
@@ -0,0 +1,135 @@
+// DOT output time for a large syntax tree.
+//
+//   dot_bench [nodes]
+//
+// Parses a generated program whose tree has about 'nodes' nodes (one
+// million by default) of nested if/repeat statements, assignments, reads
+// and writes, then times SyntaxTree::writeGraphViz() into a sink that only
+// counts the bytes (the emitter alone) and into a StringSink, best of 5.
+// Not part of 'make test'; run with 'make bench'.
+
+#include "../include/TinyScanner.h"
+#include "../include/TinyParser.h"
+#include "../include/TinyOutput.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+static double since(Clock::time_point start) {
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Discards the output, counting its bytes
+class CountingSink : public OutputSink {
+protected:
+    bool writeOut(const char*, size_t size) override {
+        bytes += size;
+        return true;
+    }
+
+public:
+    size_t bytes = 0;
+    ~CountingSink() override { flush(); }
+};
+
+static string expression(int depth) {
+    static const char* const leaves[] = {"x", "y", "count", "1", "42"};
+    if (depth > 1 || below(3) == 0) return leaves[below(5)];
+    static const char* const ops[] = {" + ", " - ", " * ", " / "};
+    return expression(depth + 1) + ops[below(4)] + expression(depth + 1);
+}
+
+// Statements until 'size' bytes, nested up to depth 5
+static void statements(string& s, int depth, size_t count, size_t size) {
+    for (size_t i = 0; i < count && (i == 0 || s.size() < size); i++) {
+        if (i > 0) s += ";\n";
+        size_t r = below(8);
+        if (r == 0 && depth < 5) {
+            s += "if " + expression(0) + " < " + expression(0) + " then\n";
+            statements(s, depth + 1, below(4) + 1, size);
+            if (below(2) == 0) {
+                s += "\nelse\n";
+                statements(s, depth + 1, below(3) + 1, size);
+            }
+            s += "\nend";
+        } else if (r == 1 && depth < 5) {
+            s += "repeat\n";
+            statements(s, depth + 1, below(4) + 1, size);
+            s += "\nuntil x = " + expression(0);
+        } else if (r == 2) {
+            s += "read x";
+        } else if (r == 3) {
+            s += "write " + expression(0);
+        } else {
+            s += "x := " + expression(0);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t target = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 1000000;
+
+    // About 3 bytes of source per node
+    string source;
+    statements(source, 0, (size_t)-1, target * 3);
+    vector<Token> tokens = Scanner(source.data(), source.size()).scanAll();
+    TinyParser parser;
+    TinyParser::ParseResult result = parser.parse(tokens);
+    if (!result.success) {
+        fprintf(stderr, "dot_bench: the generated program does not parse\n");
+        return 1;
+    }
+    const SyntaxTree& tree = result.ast;
+
+    double counted = 1e30, stored = 1e30;
+    size_t bytes = 0;
+    for (int pass = 0; pass < 5; pass++) {
+        Clock::time_point start = Clock::now();
+        {
+            CountingSink sink;
+            tree.writeGraphViz(sink);
+            sink.flush();
+            bytes = sink.bytes;
+        }
+        double seconds = since(start);
+        if (seconds < counted) counted = seconds;
+
+        string dot;
+        start = Clock::now();
+        {
+            StringSink sink(dot);
+            tree.writeGraphViz(sink);
+        }
+        seconds = since(start);
+        if (seconds < stored) stored = seconds;
+        if (dot.size() != bytes) {
+            fprintf(stderr, "dot_bench: %zu bytes into a string, %zu counted\n", dot.size(), bytes);
+            return 1;
+        }
+    }
+
+    printf("%zu nodes, %zu bytes of DOT (%.1f bytes/node)\n", tree.size(), bytes, (double)bytes / tree.size());
+    printf("  emitter only: %8.1f ms, %6.1f ns/node, %6.0f MB/s\n", counted * 1000, counted * 1e9 / tree.size(),
+           bytes / counted / 1e6);
+    printf("  into a string:%8.1f ms, %6.1f ns/node, %6.0f MB/s\n", stored * 1000, stored * 1e9 / tree.size(),
+           bytes / stored / 1e6);
+    return 0;
+}
@@ -0,0 +1,424 @@
+// Differential test: the tree walker (Interpreter), the bytecode VM and,
+// where the host supports it, native code (JitProgram) must write the same
+// values and stop with the same runtime error as a simple evaluator of the
+// generated program.
+//
+//   engine_diff [programs] [seed]
+//
+// Each program (3000 by default) is built at random from assignments,
+// reads, writes, if/else and counted repeat loops over a few variables,
+// printed with the fewest parentheses the grammar allows, and run on a
+// random input list. Literals and inputs include values near the int64
+// limits, so arithmetic wraps; divisions by zero and reads past the end of
+// the input are runtime errors. Exits 1 at the first difference.
+
+#include "../include/TinyScanner.h"
+#include "../include/TinyParser.h"
+#include "../include/TinyBytecode.h"
+#include "../include/TinyVM.h"
+#include "../include/TinyJit.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+// Variables the program assigns and reads, then one loop counter per
+// nesting level; identifiers are letters only and never keywords
+static const char* const variableNames[] = {"a", "b", "c", "x", "Yy", "nn", "ka", "kb"};
+static const size_t kAssignable = 6;
+static const size_t kVariables = sizeof(variableNames) / sizeof(variableNames[0]);
+
+// A generated program, as the evaluator below sees it
+struct Expr {
+    char op;        // 'n' number, 'v' variable, or one of + - * / < =
+    int64_t value;  // number, or variable index
+    size_t left, right;
+};
+
+struct Stmt {
+    enum Kind { ASSIGN, READ, WRITE, IF, REPEAT } kind;
+    size_t variable;
+    size_t expr;               // assigned, written or tested
+    vector<size_t> body, orElse;
+    bool hasElse;
+};
+
+struct Program {
+    vector<Expr> exprs;
+    vector<Stmt> stmts;
+    vector<size_t> top;
+
+    size_t add(const Expr& e) {
+        exprs.push_back(e);
+        return exprs.size() - 1;
+    }
+
+    size_t add(const Stmt& s) {
+        stmts.push_back(s);
+        return stmts.size() - 1;
+    }
+};
+
+static size_t number(Program& p, int64_t v) { return p.add(Expr{'n', v, 0, 0}); }
+static size_t variable(Program& p, size_t v) { return p.add(Expr{'v', (int64_t)v, 0, 0}); }
+static size_t binary(Program& p, char op, size_t l, size_t r) { return p.add(Expr{op, 0, l, r}); }
+
+static size_t randomExpr(Program& p, int depth) {
+    if (depth > 3 || below(10) < 3) {
+        if (below(2) == 0) return variable(p, below(kVariables));
+        switch (below(8)) {
+            case 0: return number(p, INT64_MAX);
+            case 1: return number(p, (int64_t)(nextRandom() >> 1));
+            default: return number(p, (int64_t)below(21));
+        }
+    }
+    static const char ops[] = "+-*/<=+*";
+    char op = ops[below(8)];
+    size_t left = randomExpr(p, depth + 1);
+    return binary(p, op, left, randomExpr(p, depth + 1));
+}
+
+static Stmt statement(Stmt::Kind kind, size_t variable, size_t expr) {
+    Stmt s;
+    s.kind = kind;
+    s.variable = variable;
+    s.expr = expr;
+    s.hasElse = false;
+    return s;
+}
+
+static vector<size_t> randomStatements(Program& p, int depth, size_t count) {
+    vector<size_t> out;
+    for (size_t i = 0; i < count; i++) {
+        size_t r = below(100);
+        if (depth < 3 && r < 25) {
+            Stmt s = statement(Stmt::IF, 0, randomExpr(p, 1));
+            s.body = randomStatements(p, depth + 1, below(3) + 1);
+            s.hasElse = r < 15;
+            if (s.hasElse) s.orElse = randomStatements(p, depth + 1, below(3) + 1);
+            out.push_back(p.add(s));
+        } else if (depth < 2 && r < 35) {
+            // k := 0; repeat ...; k := k + 1 until k = N
+            size_t counter = kAssignable + (size_t)depth;
+            out.push_back(p.add(statement(Stmt::ASSIGN, counter, number(p, 0))));
+            Stmt s = statement(Stmt::REPEAT, 0, 0);
+            s.body = randomStatements(p, depth + 1, below(3) + 1);
+            size_t next = binary(p, '+', variable(p, counter), number(p, 1));
+            s.body.push_back(p.add(statement(Stmt::ASSIGN, counter, next)));
+            s.expr = binary(p, '=', variable(p, counter), number(p, (int64_t)below(5) + 1));
+            out.push_back(p.add(s));
+        } else if (r < 45) {
+            out.push_back(p.add(statement(Stmt::READ, below(kAssignable), 0)));
+        } else if (r < 65) {
+            out.push_back(p.add(statement(Stmt::WRITE, 0, randomExpr(p, 0))));
+        } else {
+            out.push_back(p.add(statement(Stmt::ASSIGN, below(kAssignable), randomExpr(p, 0))));
+        }
+    }
+    return out;
+}
+
+// Comparison 0, additive 1, multiplicative 2, factor 3
+static int level(char op) {
+    switch (op) {
+        case '<': case '=': return 0;
+        case '+': case '-': return 1;
+        case '*': case '/': return 2;
+        default: return 3;
+    }
+}
+
+// Parenthesized only where the grammar needs it: operators are left
+// associative, and a comparison cannot be an operand of another
+static void printExpr(const Program& p, size_t id, int minimum, string& out) {
+    const Expr& e = p.exprs[id];
+    if (e.op == 'n') {
+        out += to_string(e.value);
+        return;
+    }
+    if (e.op == 'v') {
+        out += variableNames[e.value];
+        return;
+    }
+    int l = level(e.op);
+    if (l < minimum) out += '(';
+    printExpr(p, e.left, l == 0 ? 1 : l, out);
+    out += ' ';
+    out += e.op;
+    out += ' ';
+    printExpr(p, e.right, l + 1, out);
+    if (l < minimum) out += ')';
+}
+
+static void printStatements(const Program& p, const vector<size_t>& list, int indent, string& out) {
+    for (size_t i = 0; i < list.size(); i++) {
+        const Stmt& s = p.stmts[list[i]];
+        out.append((size_t)indent * 2, ' ');
+        switch (s.kind) {
+            case Stmt::ASSIGN:
+                out += string(variableNames[s.variable]) + " := ";
+                printExpr(p, s.expr, 0, out);
+                break;
+            case Stmt::READ:
+                out += string("read ") + variableNames[s.variable];
+                break;
+            case Stmt::WRITE:
+                out += "write ";
+                printExpr(p, s.expr, 0, out);
+                break;
+            case Stmt::IF:
+                out += "if ";
+                printExpr(p, s.expr, 0, out);
+                out += " then\n";
+                printStatements(p, s.body, indent + 1, out);
+                if (s.hasElse) {
+                    out.append((size_t)indent * 2, ' ');
+                    out += "else\n";
+                    printStatements(p, s.orElse, indent + 1, out);
+                }
+                out.append((size_t)indent * 2, ' ');
+                out += "end";
+                break;
+            case Stmt::REPEAT:
+                out += "repeat\n";
+                printStatements(p, s.body, indent + 1, out);
+                out.append((size_t)indent * 2, ' ');
+                out += "until ";
+                printExpr(p, s.expr, 0, out);
+                break;
+        }
+        out += i + 1 < list.size() ? ";\n" : "\n";
+    }
+}
+
+// What a run wrote and how it stopped
+struct Outcome {
+    vector<int64_t> values;
+    bool success = false;
+    string error;
+};
+
+static bool sameOutcome(const Outcome& a, const Outcome& b) {
+    return a.values == b.values && a.success == b.success && a.error == b.error;
+}
+
+static string describe(const Outcome& o) {
+    string s;
+    for (int64_t v : o.values) s += to_string(v) + " ";
+    s += o.success ? "(finished)" : "(error: " + o.error + ")";
+    return s;
+}
+
+// Evaluates the generated program directly, by the language's rules
+// rather than any engine's code
+class Evaluator {
+    const Program& program;
+    vector<int64_t> vars;
+    const vector<int64_t>& input;
+    size_t nextInput = 0;
+    Outcome& outcome;
+
+    static int64_t wrap(uint64_t v) { return (int64_t)v; }
+
+    bool eval(size_t id, int64_t& result) {
+        const Expr& e = program.exprs[id];
+        if (e.op == 'n') {
+            result = e.value;
+            return true;
+        }
+        if (e.op == 'v') {
+            result = vars[(size_t)e.value];
+            return true;
+        }
+        int64_t a, b;
+        if (!eval(e.left, a) || !eval(e.right, b)) return false;
+        switch (e.op) {
+            case '+': result = wrap((uint64_t)a + (uint64_t)b); return true;
+            case '-': result = wrap((uint64_t)a - (uint64_t)b); return true;
+            case '*': result = wrap((uint64_t)a * (uint64_t)b); return true;
+            case '<': result = a < b; return true;
+            case '=': result = a == b; return true;
+            default: break;
+        }
+        if (b == 0) {
+            outcome.error = "Division by zero";
+            return false;
+        }
+        // Truncating toward zero on magnitudes; INT64_MIN / -1 wraps
+        uint64_t ua = a < 0 ? 0 - (uint64_t)a : (uint64_t)a;
+        uint64_t ub = b < 0 ? 0 - (uint64_t)b : (uint64_t)b;
+        uint64_t q = ua / ub;
+        result = wrap((a < 0) != (b < 0) ? 0 - q : q);
+        return true;
+    }
+
+    bool run(const vector<size_t>& list) {
+        for (size_t id : list) {
+            const Stmt& s = program.stmts[id];
+            int64_t v;
+            switch (s.kind) {
+                case Stmt::ASSIGN:
+                    if (!eval(s.expr, v)) return false;
+                    vars[s.variable] = v;
+                    break;
+                case Stmt::READ:
+                    if (nextInput == input.size()) {
+                        outcome.error = string("read ") + variableNames[s.variable] + ": no more input";
+                        return false;
+                    }
+                    vars[s.variable] = input[nextInput++];
+                    break;
+                case Stmt::WRITE:
+                    if (!eval(s.expr, v)) return false;
+                    outcome.values.push_back(v);
+                    break;
+                case Stmt::IF:
+                    if (!eval(s.expr, v)) return false;
+                    if (v != 0) {
+                        if (!run(s.body)) return false;
+                    } else if (s.hasElse) {
+                        if (!run(s.orElse)) return false;
+                    }
+                    break;
+                case Stmt::REPEAT:
+                    do {
+                        if (!run(s.body) || !eval(s.expr, v)) return false;
+                    } while (v == 0);
+                    break;
+            }
+        }
+        return true;
+    }
+
+public:
+    Evaluator(const Program& p, const vector<int64_t>& values, Outcome& result)
+        : program(p), vars(kVariables, 0), input(values), outcome(result) {}
+
+    void run() { outcome.success = run(program.top); }
+};
+
+class ListInput : public ValueInput {
+    const vector<int64_t>& values;
+    size_t next = 0;
+
+public:
+    explicit ListInput(const vector<int64_t>& list) : values(list) {}
+
+    bool readValue(int64_t& value) override {
+        if (next == values.size()) return false;
+        value = values[next++];
+        return true;
+    }
+};
+
+class ListOutput : public ValueOutput {
+    vector<int64_t>& values;
+
+public:
+    explicit ListOutput(vector<int64_t>& list) : values(list) {}
+
+    void writeValue(int64_t value) override { values.push_back(value); }
+};
+
+int main(int argc, char** argv) {
+    size_t programs = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 3000;
+    if (argc > 2) rngState ^= strtoull(argv[2], nullptr, 10) * 0x9E3779B97F4A7C15ULL;
+
+    size_t finished = 0;
+    size_t native = 0;
+    for (size_t i = 0; i < programs; i++) {
+        Program program;
+        program.top = randomStatements(program, 0, below(8) + 1);
+        string text;
+        printStatements(program, program.top, 0, text);
+
+        vector<int64_t> input(below(13));
+        for (int64_t& v : input) {
+            v = below(5) == 0 ? (int64_t)nextRandom() : (int64_t)below(36) - 5;
+        }
+
+        Outcome expected;
+        Evaluator(program, input, expected).run();
+
+        vector<Token> tokens = Scanner(text.data(), text.size()).scanAll();
+        TinyParser parser;
+        TinyParser::ParseResult parsed = parser.parse(tokens);
+        if (!parsed.success) {
+            cerr << "engine_diff: program " << i << " does not parse\n" << text;
+            for (const string& error : parsed.errors) cerr << error << "\n";
+            return 1;
+        }
+
+        vector<pair<string, Outcome>> runs;
+        {
+            Outcome o;
+            ListInput in(input);
+            ListOutput out(o.values);
+            Interpreter interpreter(parsed.ast);
+            Interpreter::RunResult run = interpreter.run(in, out);
+            o.success = run.success;
+            o.error = run.error;
+            runs.push_back(make_pair(string("tree walker"), o));
+        }
+        Bytecode code;
+        BytecodeCompiler compiler;
+        if (!compiler.compile(parsed.ast, code)) {
+            cerr << "engine_diff: program " << i << " does not compile: " << compiler.error() << "\n" << text;
+            return 1;
+        }
+        {
+            Outcome o;
+            ListInput in(input);
+            ListOutput out(o.values);
+            VirtualMachine vm(code);
+            VirtualMachine::RunResult run = vm.run(in, out);
+            o.success = run.success;
+            o.error = run.error;
+            runs.push_back(make_pair(string("bytecode VM"), o));
+        }
+        JitProgram jit;
+        if (jit.compile(code)) {
+            Outcome o;
+            ListInput in(input);
+            ListOutput out(o.values);
+            JitProgram::RunResult run = jit.run(in, out);
+            o.success = run.success;
+            o.error = run.error;
+            runs.push_back(make_pair(string("native code"), o));
+            native++;
+        } else if (JitProgram::supported()) {
+            cerr << "engine_diff: program " << i << " does not translate: " << jit.error() << "\n" << text;
+            return 1;
+        }
+
+        for (const pair<string, Outcome>& run : runs) {
+            if (!sameOutcome(run.second, expected)) {
+                cerr << "engine_diff: program " << i << " differs under the " << run.first << "\n--- program\n"
+                     << text << "--- input\n";
+                for (int64_t v : input) cerr << v << " ";
+                cerr << "\n--- expected\n" << describe(expected) << "\n--- " << run.first << "\n"
+                     << describe(run.second) << "\n";
+                return 1;
+            }
+        }
+        if (expected.success) finished++;
+    }
+
+    cout << "engine_diff: " << programs << " programs (" << finished << " finishing, " << native
+         << " also as native code) run identically\n";
+    return 0;
+}
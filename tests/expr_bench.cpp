@@ -0,0 +1,91 @@
+// Parse time on expression-dense input.
+//
+//   expr_bench [megabytes] [passes]
+//
+// Generates about 'megabytes' MB (8 by default) of assignments and writes
+// whose right-hand sides are long expressions over all six binary
+// operators with some parentheses, scans it once and reports the best of
+// 'passes' (9 by default) parses with TinyParser::parse(), in ms and in
+// tokens and nodes per second. Not part of 'make test'; run with
+// 'make bench'.
+
+#include "../include/TinyScanner.h"
+#include "../include/TinyParser.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+// A term chain of 'operands' leaves; parenthesized sub-chains nest up to
+// 'depth' more levels
+static void chain(string& s, size_t operands, int depth) {
+    static const char* const leaves[] = {"x", "y", "total", "n", "1", "2", "10", "365"};
+    static const char* const ops[] = {" + ", " - ", " * ", " / ", " * ", " + "};
+    for (size_t i = 0; i < operands; i++) {
+        if (i > 0) s += ops[below(6)];
+        if (depth > 0 && below(5) == 0) {
+            s += '(';
+            chain(s, below(4) + 2, depth - 1);
+            s += ')';
+        } else {
+            s += leaves[below(8)];
+        }
+    }
+}
+
+// Expression statements, with a comparison in about one in four
+static string makeSource(size_t size) {
+    string s;
+    s.reserve(size + 4096);
+    while (s.size() < size) {
+        if (!s.empty()) s += ";\n";
+        s += below(4) == 0 ? "write " : "x := ";
+        chain(s, below(12) + 4, 2);
+        if (below(4) == 0) {
+            s += below(2) ? " < " : " = ";
+            chain(s, below(6) + 2, 2);
+        }
+    }
+    return s;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 8;
+    int passes = argc > 2 ? atoi(argv[2]) : 9;
+
+    string source = makeSource(megabytes << 20);
+    vector<Token> tokens = Scanner(source.data(), source.size()).scanAll();
+
+    TinyParser parser;
+    double best = 1e30;
+    size_t nodes = 0;
+    for (int pass = 0; pass < passes; pass++) {
+        auto start = chrono::steady_clock::now();
+        TinyParser::ParseResult result = parser.parse(tokens);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (!result.success) {
+            fprintf(stderr, "expr_bench: the generated program does not parse\n");
+            return 1;
+        }
+        nodes = result.ast.size();
+        if (seconds < best) best = seconds;
+    }
+    printf("%zu bytes, %zu tokens, %zu nodes: %.1f ms, %.2f M tokens/s, %.2f M nodes/s\n", source.size(),
+           tokens.size(), nodes, best * 1000, tokens.size() / best / 1e6, nodes / best / 1e6);
+    return 0;
+}
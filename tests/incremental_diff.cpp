@@ -0,0 +1,112 @@
+// Differential test: after every edit, IncrementalParser must give the
+// tokens, tree, success and errors that scanning and parsing the whole
+// edited text with Scanner and TinyParser give.
+//
+//   incremental_diff [rounds] [seed]
+//
+// Each round loads a sample program from data/ and applies 60 random edits
+// of TINY fragments, unbalanced keywords and comments, NULs and BOMs, with
+// error recovery on or off. Exits 1 at the first difference.
+
+#include "../include/TinyIncremental.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+static string describe(const vector<Token>& tokens, bool success, const SyntaxTree& tree,
+                       const vector<string>& errors) {
+    string s;
+    for (const Token& tok : tokens) s += tok.text() + "|" + tokenTypeToString(tok.type) + " ";
+    s += success ? "\nOK\n" + tree.toString() : "\nFAIL\n";
+    for (const string& error : errors) s += error + "\n";
+    return s;
+}
+
+static string wholeParse(const string& text, bool recover) {
+    vector<Token> tokens = Scanner(text.data(), text.size()).scanAll();
+    TinyParser parser;
+    parser.setErrorRecovery(recover);
+    TinyParser::ParseResult result = parser.parse(tokens);
+    return describe(tokens, result.success, result.ast, result.errors);
+}
+
+static string randomInsert() {
+    static const char* const pieces[] = {
+        ";", " ", "x", "1", ":=", "if ", "then ", "end", "repeat ", "until ", "{", "}", "{c}", "\n",
+        "read y", "write 3", "+", "(", ")", "<", "else ", "\xEF\xBB\xBF", "x := x + 1;",
+        "if x < 1 then y := 2 end;", "\0"
+    };
+    const size_t count = sizeof(pieces) / sizeof(pieces[0]);
+    string s;
+    for (size_t n = below(3); n > 0; n--) {
+        size_t k = below(count);
+        if (k == count - 1) s += '\0';
+        else s += pieces[k];
+    }
+    return s;
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 200;
+    if (argc > 2) rngState ^= strtoull(argv[2], nullptr, 10) * 0x9E3779B97F4A7C15ULL;
+
+    vector<string> samples;
+    static const char* const paths[] = {"data/input.txt", "data/loops.txt"};
+    for (const char* path : paths) {
+        ifstream file(path, ios::in | ios::binary);
+        if (!file) continue;
+        stringstream text;
+        text << file.rdbuf();
+        samples.push_back(text.str());
+    }
+    if (samples.empty()) samples.push_back("read x;\nif 0 < x then\n  write x\nend\n");
+
+    size_t edits = 0;
+    size_t parsed = 0;
+    for (size_t round = 0; round < rounds; round++) {
+        string text = samples[round % samples.size()];
+        bool recover = below(2) == 0;
+        IncrementalParser document;
+        document.setErrorRecovery(recover);
+        document.load(text);
+        for (int e = 0; e < 60; e++) {
+            size_t offset = below(text.size() + 1);
+            size_t removed = below(3) == 0 ? 0 : below(min<size_t>(text.size() - offset, 1 + below(12)) + 1);
+            string inserted = randomInsert();
+            text.replace(offset, removed, inserted);
+            document.edit(offset, removed, inserted);
+            edits++;
+
+            string expected = wholeParse(text, recover);
+            string actual = describe(document.tokens(), document.success(), document.tree(), document.errors());
+            if (document.text() != text || actual != expected) {
+                cerr << "incremental_diff: round " << round << ", edit " << e << " differs (error recovery "
+                     << (recover ? "on" : "off") << ")\n--- text\n" << text << "\n--- whole parse\n"
+                     << expected << "--- incremental\n" << actual;
+                return 1;
+            }
+            if (document.success()) parsed++;
+        }
+    }
+
+    cout << "incremental_diff: " << edits << " edits (" << parsed
+         << " leaving a valid program) match a whole parse\n";
+    return 0;
+}
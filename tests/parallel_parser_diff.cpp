@@ -0,0 +1,138 @@
+// Differential test: ParallelParser must give the tree, success and errors
+// of TinyParser for any token list, thread count and error mode.
+//
+//   parallel_parser_diff [programs] [seed]
+//
+// Each program (1000 by default) is a generated list of top-level
+// statements with nested if/repeat, parsed as is and after a few random
+// mutations: doubled ';' (the ';;' a segment must not end in), dropped
+// tokens, and stray 'if', 'end', 'until', 'repeat' or operators that make
+// a segment fail and force the serial fallback. Both the Token span and
+// the TokenBuffer inputs are parsed with 2 to 5 threads and a one-token
+// minimum segment, with error recovery off and on. Exits 1 at the first
+// difference.
+
+#include "../include/TinyScanner.h"
+#include "../include/TinyParser.h"
+#include "../include/TinyParallelParser.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+static string expression() {
+    static const char* const leaves[] = {"x", "y", "1", "20"};
+    static const char* const ops[] = {" + ", " * ", " - "};
+    string e = leaves[below(4)];
+    for (size_t n = below(3); n > 0; n--) e += string(ops[below(3)]) + leaves[below(4)];
+    if (below(3) == 0) e += string(below(2) ? " < " : " = ") + leaves[below(4)];
+    return below(5) == 0 ? "(" + e + ")" : e;
+}
+
+static string statements(int depth, size_t count) {
+    string s;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) s += ";\n";
+        size_t r = below(10);
+        if (r == 0 && depth < 3) {
+            s += "if " + expression() + " then " + statements(depth + 1, below(3) + 1);
+            if (below(2) == 0) s += " else " + statements(depth + 1, below(3) + 1);
+            s += " end";
+        } else if (r == 1 && depth < 3) {
+            s += "repeat " + statements(depth + 1, below(3) + 1) + " until " + expression();
+        } else if (r == 2) {
+            s += "read x";
+        } else if (r == 3) {
+            s += "write " + expression();
+        } else {
+            s += "x := " + expression();
+        }
+    }
+    return s;
+}
+
+// Insert or drop text at a random token boundary
+static void mutate(string& s) {
+    static const char* const inserts[] = {";", ";", "; ;", "if ", " end", " until ", "repeat ", "+", ":=", ")"};
+    size_t at = below(s.size() + 1);
+    while (at < s.size() && s[at] != ' ' && s[at] != '\n' && s[at] != ';') at++;
+    if (below(3) == 0) {
+        size_t end = at;
+        while (end < s.size() && (s[end] == ' ' || s[end] == '\n')) end++;
+        while (end < s.size() && s[end] != ' ' && s[end] != '\n') end++;
+        s.erase(at, end - at);
+    } else {
+        s.insert(at, string(" ") + inserts[below(sizeof(inserts) / sizeof(inserts[0]))] + " ");
+    }
+}
+
+static string describe(const TinyParser::ParseResult& r) {
+    string s = r.success ? "OK\n" + r.ast.toString() : "FAIL\n";
+    for (const string& error : r.errors) s += error + "\n";
+    return s;
+}
+
+int main(int argc, char** argv) {
+    size_t programs = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 1000;
+    if (argc > 2) rngState ^= strtoull(argv[2], nullptr, 10) * 0x9E3779B97F4A7C15ULL;
+
+    size_t checked = 0, accepted = 0, doubled = 0;
+    for (size_t p = 0; p < programs; p++) {
+        string text = statements(0, below(40) + 2);
+        for (int round = 0; round < 4; round++) {
+            vector<Token> tokens = Scanner(text.data(), text.size()).scanAll();
+            TokenBuffer buffer;
+            Scanner(text.data(), text.size()).scanAll(buffer);
+            for (size_t i = 0; i + 1 < tokens.size(); i++) {
+                if (tokens[i].type == TokenType::SEMICOLON && tokens[i + 1].type == TokenType::SEMICOLON) {
+                    doubled++;
+                    break;
+                }
+            }
+
+            for (int recover = 0; recover < 2; recover++) {
+                TinyParser serial;
+                serial.setErrorRecovery(recover != 0);
+                string expected = describe(serial.parse(tokens));
+                if (expected.compare(0, 2, "OK") == 0) accepted++;
+
+                for (unsigned threads = 2; threads <= 5; threads++) {
+                    ParallelParser fromSpan(tokens.data(), tokens.size());
+                    fromSpan.setErrorRecovery(recover != 0);
+                    string span = describe(fromSpan.parse(threads, 1));
+                    ParallelParser fromBuffer(buffer);
+                    fromBuffer.setErrorRecovery(recover != 0);
+                    string buffered = describe(fromBuffer.parse(threads, 1));
+                    if (span != expected || buffered != expected) {
+                        cerr << "parallel_parser_diff: program " << p << ", round " << round << " differs with "
+                             << threads << " threads (error recovery " << (recover ? "on" : "off")
+                             << ")\n--- program\n" << text << "\n--- TinyParser\n" << expected
+                             << "--- ParallelParser (" << (span != expected ? "tokens" : "TokenBuffer") << ")\n"
+                             << (span != expected ? span : buffered);
+                        return 1;
+                    }
+                    checked++;
+                }
+            }
+            mutate(text);
+        }
+    }
+
+    cout << "parallel_parser_diff: " << checked << " parallel parses (" << accepted / 2 << " of "
+         << programs * 4 << " token lists accepted, " << doubled << " with ';;') match TinyParser\n";
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Differential test: ParallelScanner must produce exactly the tokens of
+// Scanner::scanAll (type, text and position) for any input, thread count
+// and chunk size.
+//
+//   parallel_scanner_diff [inputs] [seed]
+//
+// Each random input (3000 by default) is built from TINY fragments, long
+// identifiers and numbers, comments (long, empty, nested-looking or
+// unterminated), stray '}' and NUL bytes, and sometimes a BOM. It is
+// scanned with 1 to 8 threads and chunks as small as one byte, so chunks
+// start inside comments and inside tokens, whole chunks are comment, and
+// tokens cover several chunks. A few larger inputs are scanned with bigger
+// chunks. Exits 1 at the first difference.
+
+#include "../include/TinyScanner.h"
+#include "../include/TinyParallelScanner.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+static string randomInput(size_t pieces) {
+    static const char* const fragments[] = {
+        "if", "then", "else", "end", "repeat", "until", "read", "write", "x", ":=", ":", "=", "<",
+        "+", "-", "*", "/", "(", ")", ";", "}", "{", "{}", "{ c }", "{{ still one }", "} {", "!"
+    };
+    string s;
+    if (below(10) == 0) s += "\xEF\xBB\xBF";
+    for (size_t i = 0; i < pieces; i++) {
+        switch (below(8)) {
+            case 0:
+                s += fragments[below(sizeof(fragments) / sizeof(fragments[0]))];
+                break;
+            case 1:
+                s.append(below(30) + 1, "abcXYZ"[below(6)]); // identifier, maybe longer than a chunk
+                break;
+            case 2:
+                s.append(below(30) + 1, "0123456789"[below(10)]);
+                break;
+            case 3: {
+                s += '{';
+                size_t n = below(60);
+                for (size_t k = 0; k < n; k++) s += "ab {;:=1\n "[below(10)];
+                if (below(8) != 0) s += '}';
+                break;
+            }
+            case 4:
+                s.append(below(20) + 1, " \t\r\n"[below(4)]);
+                break;
+            case 5:
+                if (below(20) == 0) s += '\0';
+                break;
+            default:
+                s += ' ';
+                break;
+        }
+    }
+    return s;
+}
+
+static bool sameTokens(const string& input, unsigned threads, size_t minChunk, const string& what) {
+    vector<Token> expected = Scanner(input.data(), input.size()).scanAll();
+    vector<Token> actual = ParallelScanner(input.data(), input.size()).scanAll(threads, minChunk);
+    size_t count = min(expected.size(), actual.size());
+    for (size_t i = 0; i <= count; i++) {
+        if (i == count) {
+            if (expected.size() == actual.size()) return true;
+        } else if (actual[i].type == expected[i].type && actual[i].value.data() == expected[i].value.data() &&
+                   actual[i].value.size() == expected[i].value.size()) {
+            continue;
+        }
+        cerr << "parallel_scanner_diff: " << what << " with " << threads << " threads and minChunk " << minChunk
+             << ": token " << i << " differs (" << actual.size() << " tokens, expected " << expected.size()
+             << ")\n";
+        if (i < count) {
+            cerr << "  got '" << actual[i].value << "' " << tokenTypeToString(actual[i].type) << " at "
+                 << (actual[i].value.data() - input.data()) << ", expected '" << expected[i].value << "' "
+                 << tokenTypeToString(expected[i].type) << " at " << (expected[i].value.data() - input.data())
+                 << "\n";
+        }
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t inputs = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 3000;
+    if (argc > 2) rngState ^= strtoull(argv[2], nullptr, 10) * 0x9E3779B97F4A7C15ULL;
+
+    static const size_t minChunks[] = {1, 2, 3, 5, 8, 13};
+    for (size_t i = 0; i < inputs; i++) {
+        string input = randomInput(below(40) + 1);
+        string what = "random input " + to_string(i);
+        for (unsigned threads = 1; threads <= 8; threads++) {
+            if (!sameTokens(input, threads, minChunks[below(6)], what)) return 1;
+        }
+    }
+
+    for (size_t i = 0; i < 20; i++) {
+        string input = randomInput(20000);
+        for (unsigned threads = 2; threads <= 8; threads += 3) {
+            if (!sameTokens(input, threads, 1 + below(4096), "large input " + to_string(i))) return 1;
+        }
+    }
+
+    cout << "parallel_scanner_diff: " << inputs << " random inputs scan identically with 1-8 threads\n";
+    return 0;
+}
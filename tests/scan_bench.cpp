@@ -0,0 +1,151 @@
+// Scanner throughput on realistic sources, by skip kernel.
+//
+//   scan_bench [megabytes]
+//
+// Builds three generated programs of about 'megabytes' MB each (8 by
+// default): indented code with few comments, code with a comment on most
+// lines and long block comments between statements, and code with
+// tab-and-space indentation and comments in the middle of statements. Each
+// is scanned with Scanner::scanAll(TokenBuffer&), best of 10 passes, once
+// with TINY_SIMD set to scalar, once to sse2 and once unset (the best
+// kernel this CPU has). The kernel is picked once per process, so the
+// program runs itself once per setting. Not part of 'make test'; run with
+// 'make bench'.
+
+#include "../include/TinyScanner.h"
+#include "../include/TinyTokenBuffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+static const char* const words[] = {
+    "the", "loop", "counter", "reads", "each", "value", "and", "keeps", "a", "running",
+    "total", "until", "input", "ends", "see", "note", "above", "for", "why", "this"
+};
+
+static string commentText(size_t count) {
+    string s;
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) s += ' ';
+        s += words[below(sizeof(words) / sizeof(words[0]))];
+    }
+    return s;
+}
+
+// One statement, without its ';'
+static string statement() {
+    static const char* const vars[] = {"x", "total", "count", "fact", "n"};
+    string v = vars[below(5)];
+    switch (below(4)) {
+        case 0: return "read " + v;
+        case 1: return "write " + v + " * 2";
+        case 2: return v + " := " + v + " + " + to_string(below(100));
+        default: return v + " := (" + v + " - 1) * fact";
+    }
+}
+
+// style 0: indented code; 1: commented code; 2: mixed tabs and inline comments
+static string makeSource(size_t size, int style) {
+    string s;
+    s.reserve(size + 4096);
+    int depth = 0;
+    while (s.size() < size) {
+        string indent = style == 2 ? string((size_t)depth, '\t') + string(below(3), ' ')
+                                   : string((size_t)depth * 4, ' ');
+        if (style == 1 && below(6) == 0) {
+            s += indent + "{ " + commentText(below(20) + 10) + "\n" + indent + "  " +
+                 commentText(below(15) + 5) + " }\n";
+        }
+        size_t r = below(10);
+        if (r == 0 && depth < 6) {
+            s += indent + "if x < " + to_string(below(50)) + " then\n";
+            depth++;
+            continue;
+        }
+        if (r == 1 && depth < 6) {
+            s += indent + "repeat\n";
+            depth++;
+            continue;
+        }
+        if (r == 2 && depth > 0) {
+            depth--;
+            indent = style == 2 ? string((size_t)depth, '\t') : string((size_t)depth * 4, ' ');
+            s += indent + (below(2) ? "end;\n" : "until x = 0;\n");
+            continue;
+        }
+        s += indent + statement();
+        if (style == 2 && below(3) == 0) s += " {" + commentText(below(4) + 1) + "}";
+        s += ";";
+        if (style == 1 && below(3) != 0) s += "   { " + commentText(below(8) + 2) + " }";
+        s += "\n";
+    }
+    return s;
+}
+
+// Best of several passes, in MB/s
+static double measure(const string& source, size_t& tokens) {
+    TokenBuffer buffer;
+    double best = 0;
+    for (int pass = 0; pass < 10; pass++) {
+        auto start = chrono::steady_clock::now();
+        Scanner(source.data(), source.size()).scanAll(buffer);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        tokens = buffer.size();
+        double rate = source.size() / seconds / 1e6;
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+static void setKernel(const char* value) {
+#ifdef _WIN32
+    _putenv_s("TINY_SIMD", value ? value : "");
+#else
+    if (value) setenv("TINY_SIMD", value, 1);
+    else unsetenv("TINY_SIMD");
+#endif
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 8;
+
+    // Child run: one row for the kernel this process picked
+    if (argc > 2) {
+        static const char* const styles[] = {"indented", "commented", "mixed"};
+        printf("%-8s", skipKernels().name);
+        for (int style = 0; style < 3; style++) {
+            string source = makeSource(megabytes << 20, style);
+            size_t tokens = 0;
+            printf("%12.0f", measure(source, tokens));
+            if (tokens == 0) printf(" (%s: no tokens)", styles[style]);
+        }
+        printf("\n");
+        return 0;
+    }
+
+    printf("Scanner::scanAll (MB/s), %zu MB per input\n%-8s%12s%12s%12s\n", megabytes, "kernel", "indented",
+           "commented", "mixed");
+    fflush(stdout);
+    static const char* const settings[] = {"scalar", "sse2", nullptr};
+    string command = string("\"") + argv[0] + "\" " + to_string(megabytes) + " child";
+    for (const char* setting : settings) {
+        setKernel(setting);
+        if (system(command.c_str()) != 0) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+// Differential test: the table-driven Scanner must produce exactly the
+// tokens of ReferenceScanner (type, text and position) on any input, and
+// StreamScanner the same types and text when it reads the input in chunks
+// of 1 to 7 bytes.
+//
+//   scanner_diff [inputs] [seed]
+//
+// Scans the sample programs in data/, a few inputs with tokens, comments
+// and a BOM placed across chunk boundaries, then 'inputs' random buffers
+// (20000 by default) built from TINY fragments, keywords in mixed case,
+// comments (some unterminated), stray bytes and NULs, and one large buffer
+// that crosses every SIMD block boundary. Exits 1 at the first difference.
+
+#include "../include/TinyScanner.h"
+#include "../include/TinyReferenceScanner.h"
+#include "../include/TinyStreamScanner.h"
+#include "../include/TinyTokenBuffer.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+// Random mix of the pieces the scanner's DFA and skip kernels care about
+static string randomInput(size_t pieces) {
+    static const char* const words[] = {
+        "if", "then", "else", "end", "repeat", "until", "read", "write",
+        "x", "count", "Iff", "REPEATS", "ends", "wr", "thenx"
+    };
+    static const char* const symbols[] = {
+        ":=", ":", "=", "<", "+", "-", "*", "/", "(", ")", ";", "}", "!", "@", ">", "."
+    };
+    string s;
+    if (below(20) == 0) s += "\xEF\xBB\xBF"; // UTF-8 BOM
+    for (size_t i = 0; i < pieces; i++) {
+        switch (below(9)) {
+            case 0: {
+                string w = words[below(sizeof(words) / sizeof(words[0]))];
+                for (char& c : w) {
+                    if (below(3) == 0 && c >= 'a' && c <= 'z') c = char(c - 'a' + 'A');
+                }
+                s += w;
+                break;
+            }
+            case 1:
+                s += to_string(nextRandom() % 100000);
+                break;
+            case 2:
+                s += symbols[below(sizeof(symbols) / sizeof(symbols[0]))];
+                break;
+            case 3:
+                s.append(below(40) + 1, " \t\r\n\v\f"[below(6)]);
+                break;
+            case 4: {
+                s += '{';
+                size_t n = below(80);
+                for (size_t k = 0; k < n; k++) s += (char)(' ' + below(95));
+                if (below(10) != 0) s += '}';
+                break;
+            }
+            case 5:
+                s += (char)(0x80 + below(128)); // non-ASCII byte
+                break;
+            case 6:
+                if (below(8) == 0) s += '\0';
+                break;
+            default:
+                s += ' ';
+                break;
+        }
+    }
+    return s;
+}
+
+static bool sameTokens(const string& input, const string& what) {
+    Scanner fast(input.data(), input.size());
+    ReferenceScanner reference(input.data(), input.size());
+    for (size_t index = 0;; index++) {
+        Token a = fast.nextToken();
+        Token b = reference.nextToken();
+        bool same = a.type == b.type &&
+                    (a.type == TokenType::END_OF_FILE ||
+                     (a.value.data() == b.value.data() && a.value.size() == b.value.size()));
+        if (!same) {
+            cerr << "scanner_diff: " << what << ": token " << index << " differs: Scanner gives '"
+                 << a.value << "' " << tokenTypeToString(a.type) << " at "
+                 << (a.value.data() - input.data()) << ", ReferenceScanner '" << b.value << "' "
+                 << tokenTypeToString(b.type) << " at " << (b.value.data() - input.data()) << "\n";
+            return false;
+        }
+        if (a.type == TokenType::END_OF_FILE) break;
+    }
+
+    // The batch path must agree with the token-at-a-time one
+    TokenBuffer buffer;
+    Scanner batch(input.data(), input.size());
+    batch.scanAll(buffer);
+    vector<Token> expected = ReferenceScanner(input.data(), input.size()).scanAll();
+    if (buffer.size() != expected.size()) {
+        cerr << "scanner_diff: " << what << ": scanAll() gives " << buffer.size() << " tokens, expected "
+             << expected.size() << "\n";
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (buffer.type(i) != expected[i].type || buffer.value(i).data() != expected[i].value.data() ||
+            buffer.value(i).size() != expected[i].value.size()) {
+            cerr << "scanner_diff: " << what << ": scanAll() token " << i << " differs\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// StreamScanner over 'input' with every chunk size from 1 to 7 bytes
+static bool sameStreamTokens(const string& input, const string& what) {
+    vector<Token> expected = ReferenceScanner(input.data(), input.size()).scanAll();
+    for (size_t chunk = 1; chunk <= 7; chunk++) {
+        istringstream in(input);
+        StreamScanner stream(in, chunk);
+        for (size_t index = 0;; index++) {
+            Token a = stream.nextToken();
+            bool done = index == expected.size();
+            bool same = done ? a.type == TokenType::END_OF_FILE
+                             : a.type == expected[index].type && a.text() == expected[index].text();
+            if (!same) {
+                cerr << "scanner_diff: " << what << ": StreamScanner with " << chunk << "-byte chunks: token "
+                     << index << " is '" << a.value << "' " << tokenTypeToString(a.type) << ", expected ";
+                if (done) cerr << "the end of input\n";
+                else cerr << "'" << expected[index].value << "' " << tokenTypeToString(expected[index].type) << "\n";
+                return false;
+            }
+            if (done) break;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t inputs = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 20000;
+    if (argc > 2) rngState ^= strtoull(argv[2], nullptr, 10) * 0x9E3779B97F4A7C15ULL;
+
+    static const char* const samples[] = {"data/input.txt", "data/loops.txt"};
+    for (const char* path : samples) {
+        ifstream file(path, ios::in | ios::binary);
+        if (!file) continue;
+        stringstream text;
+        text << file.rdbuf();
+        if (!sameTokens(text.str(), path) || !sameStreamTokens(text.str(), path)) return 1;
+    }
+
+    // Tokens ending exactly at a chunk end, tokens longer than a chunk,
+    // comments spanning chunks, and a BOM split across chunks
+    const string boundaries[] = {
+        "abcdefg", "x:=1234567;", "averyveryverylongidentifier := 12345678901234567890",
+        "{a comment that spans many chunks}x", "{unterminated comment", "{}{}{ }:", string("a\0{b}c", 7),
+        string("{a\0b}c", 6), "\xEF\xBB\xBFread x", "\xEF\xBB\xBF", "\xEF\xBBx", "  \t\r\n  if", ":", "x:",
+        "12:=3"
+    };
+    for (const string& input : boundaries) {
+        if (!sameTokens(input, "boundary case") || !sameStreamTokens(input, "boundary case")) return 1;
+    }
+
+    for (size_t i = 0; i < inputs; i++) {
+        string input = randomInput(below(60) + 1);
+        string what = "random input " + to_string(i);
+        if (!sameTokens(input, what) || !sameStreamTokens(input, what)) return 1;
+    }
+    if (!sameTokens(randomInput(400000), "large input")) return 1;
+
+    cout << "scanner_diff: " << inputs << " random inputs and the samples scan identically, also as 1-7 byte "
+            "chunks\n";
+    return 0;
+}
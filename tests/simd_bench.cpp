@@ -0,0 +1,85 @@
+// Throughput of the whitespace and comment skip kernels, by run length.
+//
+//   simd_bench [megabytes]
+//
+// Each buffer holds runs of N spaces (or comments of N bytes) separated by
+// one-byte tokens, and is skipped run by run the way the scanner calls the
+// kernels. Reports MB/s for the scalar, SSE2 and AVX2 kernels that this
+// build and CPU support. Not part of 'make test'; run with 'make bench'.
+
+#include "../include/TinySimd.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct Kernel {
+    const char* name;
+    size_t (*skipSpaces)(const char*, size_t, size_t);
+    size_t (*findCommentEnd)(const char*, size_t, size_t);
+};
+
+// Runs of 'run' filler bytes, each followed by 'stop', up to 'size' bytes
+static string makeBuffer(size_t size, size_t run, char filler, char stop) {
+    string s;
+    s.reserve(size + run + 1);
+    while (s.size() < size) {
+        s.append(run, filler);
+        s += stop;
+    }
+    return s;
+}
+
+// Best of several passes over the buffer, in MB/s
+static double measure(size_t (*kernel)(const char*, size_t, size_t), const string& buffer, size_t& check) {
+    const char* s = buffer.data();
+    size_t len = buffer.size();
+    double best = 0;
+    for (int pass = 0; pass < 20; pass++) {
+        auto start = chrono::steady_clock::now();
+        size_t pos = 0;
+        size_t runs = 0;
+        while (pos < len) {
+            pos = kernel(s, pos, len) + 1;
+            runs++;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        check += runs;
+        double rate = len / seconds / 1e6;
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 4;
+    size_t size = megabytes << 20;
+
+    vector<Kernel> kernels = {{"scalar", skipSpacesScalar, findCommentEndScalar}};
+#ifdef TINY_HAVE_SSE2
+    kernels.push_back({"sse2", skipSpacesSse2, findCommentEndSse2});
+#endif
+#ifdef TINY_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) kernels.push_back({"avx2", skipSpacesAvx2, findCommentEndAvx2});
+#endif
+
+    static const size_t runs[] = {1, 2, 4, 8, 12, 16, 24, 32, 48, 64, 128, 512};
+    size_t check = 0;
+    for (int comments = 0; comments < 2; comments++) {
+        printf("%s\n%8s", comments ? "findCommentEnd (MB/s)" : "skipSpaces (MB/s)", "run");
+        for (const Kernel& k : kernels) printf("%10s", k.name);
+        printf("\n");
+        for (size_t run : runs) {
+            string buffer = comments ? makeBuffer(size, run, 'c', '}') : makeBuffer(size, run, ' ', 'x');
+            printf("%8zu", run);
+            for (const Kernel& k : kernels) {
+                printf("%10.0f", measure(comments ? k.findCommentEnd : k.skipSpaces, buffer, check));
+            }
+            printf("\n");
+        }
+    }
+    return check == 0;
+}
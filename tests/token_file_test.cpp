@@ -0,0 +1,175 @@
+// Round-trip and rejection test for binary token files (TinyTokenFile.h).
+//
+//   token_file_test [lists] [seed]
+//
+// Writes random token lists (200 by default, some long enough that
+// TokenFileWriter spills them to its temporary files, plus an empty one)
+// and loads them back with TokenFile, which must give the same types and
+// values. Then every truncation of a small file, and files with a wrong
+// magic, byte order or header count, a broken string table, an invalid
+// type or an out-of-range string id, must be rejected with
+// std::runtime_error. Exits 1 at the first failure.
+
+#include "../include/TinyTokenFile.h"
+#include "../include/TinyScanner.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+// File bytes in 4-byte aligned storage, as TokenFile requires
+struct FileImage {
+    vector<uint32_t> words;
+    size_t size = 0;
+
+    explicit FileImage(const string& bytes) : words(bytes.size() / 4 + 1), size(bytes.size()) {
+        if (size > 0) memcpy(words.data(), bytes.data(), size);
+    }
+
+    const char* data() const { return reinterpret_cast<const char*>(words.data()); }
+};
+
+static string writeFile(const vector<Token>& tokens) {
+    TokenFileWriter writer;
+    for (const Token& tok : tokens) writer.add(tok);
+    string bytes;
+    {
+        StringSink sink(bytes);
+        writer.write(sink);
+    }
+    return bytes;
+}
+
+static string randomSource(size_t pieces) {
+    static const char* const fragments[] = {
+        "if", "then", "end", "repeat", "until", "read", "write", "x", "total", ":=", "<", "=", "+",
+        "-", "*", "/", "(", ")", ";", "!", "@", "}"
+    };
+    string s;
+    for (size_t i = 0; i < pieces; i++) {
+        if (below(4) == 0) s += to_string(below(100000));
+        else s += fragments[below(sizeof(fragments) / sizeof(fragments[0]))];
+        s += ' ';
+    }
+    return s;
+}
+
+static bool roundTrip(const string& source, const string& what) {
+    vector<Token> tokens = Scanner(source.data(), source.size()).scanAll();
+    FileImage image(writeFile(tokens));
+    try {
+        TokenFile file(image.data(), image.size);
+        if (file.size() != tokens.size()) {
+            cerr << "token_file_test: " << what << ": " << file.size() << " tokens loaded, " << tokens.size()
+                 << " written\n";
+            return false;
+        }
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (file.type(i) != tokens[i].type || file.value(i).str() != tokens[i].text()) {
+                cerr << "token_file_test: " << what << ": token " << i << " loads as '" << file.value(i) << "' "
+                     << tokenTypeToString(file.type(i)) << ", written as '" << tokens[i].value << "' "
+                     << tokenTypeToString(tokens[i].type) << "\n";
+                return false;
+            }
+        }
+    } catch (const exception& e) {
+        cerr << "token_file_test: " << what << ": rejected: " << e.what() << "\n";
+        return false;
+    }
+    return true;
+}
+
+static bool rejected(const string& bytes, const string& what) {
+    FileImage image(bytes);
+    try {
+        TokenFile file(image.data(), image.size);
+    } catch (const runtime_error&) {
+        return true;
+    }
+    cerr << "token_file_test: " << what << " is accepted\n";
+    return false;
+}
+
+template <class T>
+static void poke(string& bytes, size_t offset, T value) {
+    memcpy(&bytes[offset], &value, sizeof(value));
+}
+
+int main(int argc, char** argv) {
+    size_t lists = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 200;
+    if (argc > 2) rngState ^= strtoull(argv[2], nullptr, 10) * 0x9E3779B97F4A7C15ULL;
+
+    if (!roundTrip("", "empty list")) return 1;
+    for (size_t i = 0; i < lists; i++) {
+        size_t pieces = i % 20 == 0 ? 70000 + below(70000) : below(200) + 1; // some past one spill block
+        if (!roundTrip(randomSource(pieces), "list " + to_string(i))) return 1;
+    }
+
+    // A small valid file: 7 tokens, 6 distinct strings
+    string source = "read x; x := x + 10";
+    vector<Token> tokens = Scanner(source.data(), source.size()).scanAll();
+    string good = writeFile(tokens);
+    const size_t h = sizeof(TokenFileHeader);
+    const size_t typesSize = (tokens.size() + 3) / 4 * 4;
+    const size_t offsetsAt = h + typesSize + tokens.size() * 4;
+
+    for (size_t n = 0; n < good.size(); n++) {
+        if (!rejected(good.substr(0, n), "a file cut to " + to_string(n) + " bytes")) return 1;
+    }
+    if (!rejected(good + string(4, '\0'), "a file with trailing bytes")) return 1;
+
+    string bad = good;
+    bad[7] = '2';
+    if (!rejected(bad, "a wrong magic")) return 1;
+    bad = good;
+    poke<uint32_t>(bad, offsetof(TokenFileHeader, byteOrder), 0x04030201);
+    if (!rejected(bad, "a swapped byte order")) return 1;
+    bad = good;
+    poke<uint64_t>(bad, offsetof(TokenFileHeader, tokenCount), tokens.size() + 1);
+    if (!rejected(bad, "a token count too large")) return 1;
+    bad = good;
+    poke<uint64_t>(bad, offsetof(TokenFileHeader, tokenCount), (uint64_t)-1);
+    if (!rejected(bad, "a huge token count")) return 1;
+    bad = good;
+    poke<uint64_t>(bad, offsetof(TokenFileHeader, stringCount), (uint64_t)-1);
+    if (!rejected(bad, "a huge string count")) return 1;
+    bad = good;
+    poke<uint64_t>(bad, offsetof(TokenFileHeader, stringBytes), 1);
+    if (!rejected(bad, "a string size that does not match")) return 1;
+    bad = good;
+    bad[h] = (char)TokenType::END_OF_FILE;
+    if (!rejected(bad, "an END_OF_FILE token")) return 1;
+    bad = good;
+    bad[h + 1] = (char)0xFF;
+    if (!rejected(bad, "an unknown token type")) return 1;
+    bad = good;
+    poke<uint32_t>(bad, h + typesSize, 1000);
+    if (!rejected(bad, "a string id out of range")) return 1;
+    bad = good;
+    poke<uint32_t>(bad, offsetsAt, 1);
+    if (!rejected(bad, "a string table not starting at 0")) return 1;
+    bad = good;
+    poke<uint32_t>(bad, offsetsAt + 8, 0xFFFF);
+    if (!rejected(bad, "decreasing string offsets")) return 1;
+
+    cout << "token_file_test: " << lists << " random token lists load back unchanged; truncated and corrupt "
+            "files are rejected\n";
+    return 0;
+}
@@ -0,0 +1,211 @@
+// Test for the token dump reader (TinyTokenText.h) against a plain
+// line-by-line reference.
+//
+//   token_text_test [dumps] [seed]
+//
+// Reads hand-written dumps with CRLF line ends, blank lines, a ',' as an
+// UNKNOWN token's value, no final newline, unknown type names, "value,TYPE"
+// with no blanks and lines with no ',', each alone and after enough lines
+// that it is read by the 64-byte block loop rather than the tail. Then
+// 'dumps' random dumps (2000 by default, some past one batch of lines)
+// mixing all of these. TokenTextReader must give the same tokens (values
+// as views into the dump), result and first unknown type name and line as
+// the reference. Exits 1 at the first difference.
+
+#include "../include/TinyTokenText.h"
+#include "../include/TinyTokenBuffer.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+
+using namespace std;
+
+static uint64_t rngState = 88172645463325252ULL;
+
+static uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static size_t below(size_t n) { return (size_t)(nextRandom() % n); }
+
+struct Result {
+    vector<Token> tokens;
+    bool ok = true;
+    SourceView badType;
+    size_t badLine = 0;
+};
+
+static bool isBlank(char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; }
+
+// One line at a time: split at the last ',', trim both sides, look the
+// type name up
+static Result referenceRead(const string& text) {
+    Result r;
+    size_t line = 0;
+    for (size_t begin = 0; begin < text.size(); begin = text.find('\n', begin) + 1) {
+        line++;
+        size_t end = text.find('\n', begin);
+        if (end == string::npos) end = text.size();
+        size_t comma = text.rfind(',', end == 0 ? 0 : end - 1);
+        if (comma != string::npos && comma >= begin) {
+            size_t valueBegin = begin, valueEnd = comma;
+            while (valueBegin < valueEnd && isBlank(text[valueBegin])) valueBegin++;
+            while (valueEnd > valueBegin && isBlank(text[valueEnd - 1])) valueEnd--;
+            size_t typeBegin = comma + 1, typeEnd = end;
+            while (typeBegin < typeEnd && isBlank(text[typeBegin])) typeBegin++;
+            while (typeEnd > typeBegin && isBlank(text[typeEnd - 1])) typeEnd--;
+            TokenType type;
+            if (!tokenTypeFromName(text.data() + typeBegin, typeEnd - typeBegin, type)) {
+                type = TokenType::UNKNOWN;
+                if (r.ok) {
+                    r.ok = false;
+                    r.badType = SourceView(text.data() + typeBegin, typeEnd - typeBegin);
+                    r.badLine = line;
+                }
+            }
+            r.tokens.push_back(Token(SourceView(text.data() + valueBegin, valueEnd - valueBegin), type));
+        }
+        if (end == text.size()) break;
+    }
+    return r;
+}
+
+static Result readerRead(const string& text) {
+    Result r;
+    TokenBuffer buffer;
+    TokenTextReader reader(text.data(), text.size());
+    r.ok = reader.read(buffer);
+    r.badType = reader.unknownType();
+    r.badLine = reader.unknownTypeLine();
+    for (size_t i = 0; i < buffer.size(); i++) r.tokens.push_back(buffer[i]);
+    return r;
+}
+
+static bool sameView(SourceView a, SourceView b) { return a.data() == b.data() && a.size() == b.size(); }
+
+static bool sameRead(const string& text, const string& what) {
+    Result want = referenceRead(text);
+    Result got = readerRead(text);
+    string problem;
+    if (got.tokens.size() != want.tokens.size()) {
+        problem = to_string(got.tokens.size()) + " tokens, expected " + to_string(want.tokens.size());
+    }
+    for (size_t i = 0; problem.empty() && i < want.tokens.size(); i++) {
+        if (got.tokens[i].type != want.tokens[i].type || !sameView(got.tokens[i].value, want.tokens[i].value)) {
+            problem = "token " + to_string(i) + " is '" + got.tokens[i].text() + "' " +
+                      tokenTypeToString(got.tokens[i].type) + ", expected '" + want.tokens[i].text() + "' " +
+                      tokenTypeToString(want.tokens[i].type);
+        }
+    }
+    if (problem.empty() && (got.ok != want.ok || !sameView(got.badType, want.badType) || got.badLine != want.badLine)) {
+        problem = "unknown type '" + got.badType.str() + "' on line " + to_string(got.badLine) + ", expected '" +
+                  want.badType.str() + "' on line " + to_string(want.badLine);
+    }
+    if (!problem.empty()) {
+        cerr << "token_text_test: " << what << ": " << problem << "\n";
+        return false;
+    }
+    return true;
+}
+
+// A hand-written case, also checked against what it must read as
+struct Case {
+    const char* what;
+    const char* text;
+    size_t tokens;
+    const char* firstValue;
+    TokenType firstType;
+    const char* badType; // null if every type name is known
+    size_t badLine;
+};
+
+static const Case cases[] = {
+    {"CRLF line ends", "x , Identifier\r\n12 , number\r\n", 2, "x", TokenType::IDENTIFIER, nullptr, 0},
+    {"blank lines", "\n\n  \nx , Identifier\n\r\n\n", 1, "x", TokenType::IDENTIFIER, nullptr, 0},
+    {"',' as a value", ", , UNKNOWN\n,,UNKNOWN\n", 2, ",", TokenType::UNKNOWN, nullptr, 0},
+    {"no final newline", "x , Identifier\n:= , assign", 2, "x", TokenType::IDENTIFIER, nullptr, 0},
+    {"no final newline after CR", "read , READ\r", 1, "read", TokenType::READ, nullptr, 0},
+    {"unknown type names", "x , Identifier\ny , FOO\nz , identifier\n", 3, "x", TokenType::IDENTIFIER, "FOO", 2},
+    {"an empty type name", "x ,\n", 1, "x", TokenType::UNKNOWN, "", 1},
+    {"no blanks", "x,Identifier\n;,SEMICOLON\n", 2, "x", TokenType::IDENTIFIER, nullptr, 0},
+    {"tabs", "\tx\t,\tIdentifier\t\n", 1, "x", TokenType::IDENTIFIER, nullptr, 0},
+    {"lines with no ','", "hello\nx , Identifier\nworld", 1, "x", TokenType::IDENTIFIER, nullptr, 0},
+    {"an empty dump", "", 0, nullptr, TokenType::UNKNOWN, nullptr, 0},
+};
+
+static bool checkCase(const Case& c) {
+    string text = c.text;
+    TokenBuffer buffer;
+    TokenTextReader reader(text.data(), text.size());
+    bool ok = reader.read(buffer);
+    bool right = buffer.size() == c.tokens && ok == (c.badType == nullptr) &&
+                 (c.tokens == 0 || (buffer.value(0).str() == c.firstValue && buffer.type(0) == c.firstType)) &&
+                 (c.badType == nullptr || (reader.unknownType().str() == c.badType &&
+                                           reader.unknownTypeLine() == c.badLine));
+    if (!right) {
+        cerr << "token_text_test: " << c.what << ": " << buffer.size() << " tokens, first unknown type '"
+             << reader.unknownType() << "' on line " << reader.unknownTypeLine() << "\n";
+        return false;
+    }
+    if (!sameRead(text, c.what)) return false;
+
+    // The same after 300 lines (more than one batch), so it is read by the
+    // block loop; a CRLF dump gets CRLF ends on the lines before it too
+    bool crlf = text.find('\r') != string::npos;
+    string prefix;
+    for (size_t i = 0; i < 300; i++) prefix += i % 2 && crlf ? "count , Identifier\r\n" : "count , Identifier\n";
+    return sameRead(prefix + text, string(c.what) + " after 300 lines");
+}
+
+static string randomDump(size_t lines) {
+    static const char* const values[] = {
+        "x", "total", "12", "365", ":=", ";", "(", ")", ",", "", "if", "a_rather_long_identifier_that_crosses_a_block_"
+        "boundary_on_its_own_line",
+    };
+    static const char* const types[] = {
+        "Identifier", "number", "assign", "SEMICOLON", "OPENBRACKET", "CLOSEDBRACKET", "IF", "UNKNOWN", "MULT",
+        "LESSTHAN", "NUMBER", "FOO", "", "identifier", "AVERYLONGTYPENAME", "IFF",
+    };
+    static const char* const separators[] = {" , ", " , ", " , ", ",", " ,", ", ", "\t,\t", "  ,  "};
+    static const char* const ends[] = {"\n", "\n", "\n", "\r\n", " \n", "\t\r\n"};
+    size_t names = below(2) == 0 ? sizeof(types) / sizeof(types[0]) : 11; // the first 11 are known
+    string s;
+    for (size_t i = 0; i < lines; i++) {
+        size_t r = below(40);
+        if (r == 0) {
+            s += "\n";
+        } else if (r == 1) {
+            s += "no comma here\n";
+        } else {
+            if (below(8) == 0) s += ' ';
+            s += values[below(sizeof(values) / sizeof(values[0]))];
+            s += separators[below(sizeof(separators) / sizeof(separators[0]))];
+            s += types[below(below(4) == 0 ? names : 11)];
+            s += ends[below(sizeof(ends) / sizeof(ends[0]))];
+        }
+    }
+    if (below(2) == 0 && !s.empty()) s.resize(s.size() - 1 - below(s.size() < 3 ? 1 : 3));
+    return s;
+}
+
+int main(int argc, char** argv) {
+    size_t dumps = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 2000;
+    if (argc > 2) rngState ^= strtoull(argv[2], nullptr, 10) * 0x9E3779B97F4A7C15ULL;
+
+    for (const Case& c : cases) {
+        if (!checkCase(c)) return 1;
+    }
+    for (size_t i = 0; i < dumps; i++) {
+        size_t lines = i % 50 == 0 ? 2000 + below(20000) : below(300);
+        if (!sameRead(randomDump(lines), "dump " + to_string(i))) return 1;
+    }
+
+    cout << "token_text_test: " << sizeof(cases) / sizeof(cases[0]) << " edge cases and " << dumps
+         << " random dumps read as by the reference\n";
+    return 0;
+}